@@ -0,0 +1,362 @@
+#include "game.h"
+#include <unistd.h>
+#include <fcntl.h>
+
+/* Number of timed runs of every benchmark, the median of which is reported */
+#define BENCH_REPEATS 5
+
+/* Shortest time in seconds a single run of a benchmark must take */
+#define BENCH_MIN_TIME 0.05
+
+/* Number of positions cycled through by the valid_move benchmark */
+#define BENCH_POSITIONS 4096
+
+/* Number of threads of the threaded board scan benchmarks */
+#define BENCH_THREADS 4
+
+/* Seed of every generated tile file and position list */
+#define BENCH_SEED 2310
+
+/*
+    Everything an operation being benchmarked works on: a game with its
+    board and tiles, the file the operation reads or writes, and positions
+    to be tested.
+*/
+typedef struct {
+    Game* game;
+    char* path;
+    int positions[BENCH_POSITIONS][3];
+    long long cursor;
+    long long hits;
+} Workload;
+
+/* A single operation of a benchmark */
+typedef void (*Operation)(Workload*);
+
+/* Only benchmarks whose name contains the filter are run */
+static char* filter = NULL;
+
+/*
+    Runs an operation the given number of times.
+
+    @param operation the operation to be run
+    @param workload the workload of the operation
+    @param iterations the number of times the operation is run
+    @returns the time taken in seconds
+*/
+static double time_operation(Operation operation, Workload* workload,
+        long long iterations) {
+    double started = current_time();
+    for (long long iteration = 0; iteration < iterations; iteration++) {
+        operation(workload);
+    }
+    return current_time() - started;
+}
+
+/*
+    Compares two times for sorting.
+
+    @param first the first time
+    @param second the second time
+    @returns the order of the times
+*/
+static int compare_times(const void* first, const void* second) {
+    double difference = *(const double*) first - *(const double*) second;
+    return (difference > 0) - (difference < 0);
+}
+
+/*
+    Benchmarks an operation. The number of iterations is doubled until a run
+    takes at least BENCH_MIN_TIME, which also warms up the caches, then the
+    median and best time per operation of BENCH_REPEATS runs is reported.
+
+    @param name the name of the benchmark
+    @param operation the operation to be benchmarked
+    @param workload the workload of the operation
+    @param quiet whether stdout is discarded while the operation runs
+*/
+static void measure(char* name, Operation operation, Workload* workload,
+        bool quiet) {
+    if (filter != NULL && strstr(name, filter) == NULL) {
+        return;
+    }
+    int savedOut = -1;
+    if (quiet) {
+        fflush(stdout);
+        savedOut = dup(STDOUT_FILENO);
+        int discard = open("/dev/null", O_WRONLY);
+        dup2(discard, STDOUT_FILENO);
+        close(discard);
+    }
+
+    long long iterations = 1;
+    while (time_operation(operation, workload, iterations) < BENCH_MIN_TIME) {
+        iterations *= 2;
+    }
+    double samples[BENCH_REPEATS];
+    for (int repeat = 0; repeat < BENCH_REPEATS; repeat++) {
+        samples[repeat] = time_operation(operation, workload, iterations) /
+                iterations;
+    }
+
+    if (quiet) {
+        fflush(stdout);
+        dup2(savedOut, STDOUT_FILENO);
+        close(savedOut);
+    }
+    qsort(samples, BENCH_REPEATS, sizeof(double), compare_times);
+    double median = samples[BENCH_REPEATS / 2];
+    printf("%-44s %14.1f ns/op %14.0f ops/s (best %.1f ns/op, %lld x %d)\n",
+            name, median * 1e9, 1 / median, samples[0] * 1e9, iterations,
+            BENCH_REPEATS);
+    fflush(stdout);
+}
+
+/*
+    Operation testing the next position of the workload with valid_move.
+
+    @param workload contains the game and positions
+*/
+static void run_valid_move(Workload* workload) {
+    Game* game = workload->game;
+    int* command = workload->positions[workload->cursor++ % BENCH_POSITIONS];
+    workload->hits += valid_move(command, game->gameBoard, game->tiles);
+}
+
+/*
+    Operation checking whether the first player has any possible move.
+
+    @param workload contains the game
+*/
+static void run_check_possible_move(Workload* workload) {
+    workload->hits += check_possible_move(workload->game,
+            workload->game->player1);
+}
+
+/*
+    Operation drawing the board of the game.
+
+    @param workload contains the game
+*/
+static void run_grid_display(Workload* workload) {
+    grid_display(workload->game->gameBoard);
+}
+
+/*
+    Operation saving the game to the path of the workload.
+
+    @param workload contains the game and path
+*/
+static void run_save_game(Workload* workload) {
+    char* tokens[2] = {"save", workload->path};
+    save_game(workload->game, tokens);
+}
+
+/*
+    Operation loading the game saved at the path of the workload.
+
+    @param workload contains the game and path
+*/
+static void run_load_saved_game(Workload* workload) {
+    workload->hits += load_saved_game(workload->path, workload->game);
+}
+
+/*
+    Operation loading the tile file at the path of the workload into new
+    tiles.
+
+    @param workload contains the game and path
+*/
+static void run_validate_tile_file(Workload* workload) {
+    Game* game = workload->game;
+    free_tiles(game->tiles);
+    game->tiles = initialise_tile_list();
+    workload->hits += validate_tile_file(workload->path, game->tiles);
+}
+
+/*
+    Operation rotating every tile of the game.
+
+    @param workload contains the game
+*/
+static void run_rotate_tile(Workload* workload) {
+    rotate_tile(workload->game->tiles);
+}
+
+/*
+    Writes a tile file of randomly generated tiles to a temporary file.
+
+    @param total the number of tiles in the file
+    @returns the path of the file, to be removed and freed afterwards
+*/
+static char* write_tile_file(int total) {
+    char* path = strdup("/tmp/fitz-bench-XXXXXX");
+    FILE* file = fdopen(mkstemp(path), "w");
+    uint64_t random = BENCH_SEED + total;
+    for (int tile = 0; tile < total; tile++) {
+        if (tile > 0) {
+            fprintf(file, "\n");
+        }
+        for (int row = 0; row < TILE_GRID_SQR_DIM; row++) {
+            for (int col = 0; col < TILE_GRID_SQR_DIM; col++) {
+                // About a third of the cells of a tile are placeable
+                fputc(next_random(&random) % 3 == 0 ? '!' : ',', file);
+            }
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+    return path;
+}
+
+/*
+    Creates a game on a board of the given dimension, filled by Type 2
+    players until the given fraction of the board is occupied or the game
+    has ended.
+
+    @param tilePath the tile file of the game
+    @param height the height of the board
+    @param width the width of the board
+    @param fill the fraction of the board to be occupied, above one plays
+    the whole game
+    @returns the game in progress with its index of legal moves built
+*/
+static Game* create_board(char* tilePath, int height, int width,
+        double fill) {
+    Game* game = initialise_game();
+    game->options.headless = true;
+    validate_player_type("2", "2", game);
+    validate_tile_file(tilePath, game->tiles);
+    reallocate_grid(game->gameBoard, height, width);
+    game->moves = initialise_move_index(game->gameBoard, game->tiles);
+
+    Player* players[2] = {game->player1, game->player2};
+    long long target = (long long) (fill * height * width);
+    long long occupied = 0;
+    while (occupied < target) {
+        MoveSearch search;
+        prepare_player_search(game, players[game->turn], &search);
+        if (!find_move(game, &search)) {
+            break;
+        }
+        Tile* tile = &game->tiles->list[game->tiles->current];
+        occupied += tile->rotations[search.move[2] / 90].cellCount;
+        play_search_move(game, &search);
+    }
+    return game;
+}
+
+/*
+    Benchmarks the board operations on boards of the given dimension when
+    empty, half full and at the end of a game.
+
+    @param tilePath the tile file of the games
+    @param size the height and width of the boards
+*/
+static void bench_boards(char* tilePath, int size) {
+    char* fills[3] = {"empty", "half", "full"};
+    double fractions[3] = {0, 0.5, 2};
+    char name[80];
+    Workload* workload = malloc(sizeof(Workload));
+    workload->path = strdup("/tmp/fitz-bench-XXXXXX");
+    close(mkstemp(workload->path));
+
+    for (int fill = 0; fill < 3; fill++) {
+        Game* game = create_board(tilePath, size, size, fractions[fill]);
+        workload->game = game;
+        workload->cursor = 0;
+        uint64_t random = BENCH_SEED;
+        for (int each = 0; each < BENCH_POSITIONS; each++) {
+            int* command = workload->positions[each];
+            command[0] = next_random(&random) % (size + 4) - 2;
+            command[1] = next_random(&random) % (size + 4) - 2;
+            command[2] = next_random(&random) % POSSIBLE_ROTATION * 90;
+        }
+
+        sprintf(name, "valid_move %dx%d %s", size, size, fills[fill]);
+        measure(name, run_valid_move, workload, false);
+        sprintf(name, "check_possible_move %dx%d %s", size, size,
+                fills[fill]);
+        measure(name, run_check_possible_move, workload, false);
+        // The same check scanning the board instead of using the index
+        MoveIndex* index = game->moves;
+        game->moves = NULL;
+        sprintf(name, "check_possible_move scan %dx%d %s", size, size,
+                fills[fill]);
+        measure(name, run_check_possible_move, workload, false);
+        // The same scan split across threads
+        game->options.threads = BENCH_THREADS;
+        sprintf(name, "check_possible_move scan %d threads %dx%d %s",
+                BENCH_THREADS, size, size, fills[fill]);
+        measure(name, run_check_possible_move, workload, false);
+        game->options.threads = 1;
+        game->moves = index;
+        sprintf(name, "grid_display %dx%d %s", size, size, fills[fill]);
+        measure(name, run_grid_display, workload, true);
+        sprintf(name, "save_game %dx%d %s", size, size, fills[fill]);
+        measure(name, run_save_game, workload, false);
+        // Loading replaces the board, so the index no longer applies
+        free_move_index(game->moves);
+        game->moves = NULL;
+        sprintf(name, "load_saved_game %dx%d %s", size, size, fills[fill]);
+        measure(name, run_load_saved_game, workload, false);
+        // The same board saved and loaded in the binary format
+        game->options.binarySaves = true;
+        sprintf(name, "save_game binary %dx%d %s", size, size, fills[fill]);
+        measure(name, run_save_game, workload, false);
+        sprintf(name, "load_saved_game binary %dx%d %s", size, size, 
+                fills[fill]);
+        measure(name, run_load_saved_game, workload, false);
+        free_game(game);
+    }
+    remove(workload->path);
+    free(workload->path);
+    free(workload);
+}
+
+/*
+    Benchmarks loading and rotating a tile file with the given number of
+    tiles.
+
+    @param total the number of tiles in the file
+*/
+static void bench_tiles(int total) {
+    char name[80];
+    Workload* workload = malloc(sizeof(Workload));
+    workload->game = initialise_game();
+    workload->path = write_tile_file(total);
+    sprintf(name, "validate_tile_file %d tiles", total);
+    measure(name, run_validate_tile_file, workload, false);
+    sprintf(name, "rotate_tile %d tiles", total);
+    measure(name, run_rotate_tile, workload, false);
+    remove(workload->path);
+    free(workload->path);
+    free_game(workload->game);
+    free(workload);
+}
+
+/*
+    Runs the benchmarks of the engine with fixed workloads, reporting the
+    time per operation and operations per second of each.
+
+    @param argc the number of arguments
+    @param argv an optional filter, only benchmarks containing it are run
+    @returns zero
+*/
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        filter = argv[1];
+    }
+    int sizes[3] = {10, 100, 999};
+    int tileCounts[4] = {1, 100, 10000, 100000};
+    char* tilePath = write_tile_file(2);
+    for (int size = 0; size < 3; size++) {
+        bench_boards(tilePath, sizes[size]);
+    }
+    for (int count = 0; count < 4; count++) {
+        bench_tiles(tileCounts[count]);
+    }
+    remove(tilePath);
+    free(tilePath);
+    return 0;
+}
@@ -1,11 +1,13 @@
 #ifndef FITZ_H
 #define FITZ_H
+#define _POSIX_C_SOURCE 200809L
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
 #include <limits.h>
+#include <stdint.h>
 
 /* Enum to store all possible error and their respective exit codes */
 typedef enum {
@@ -23,6 +25,8 @@ typedef enum {
 
 typedef enum {
     SAVE_FILE,
+    UNDO_MOVE,
+    REDO_MOVE,
     NO_TOKEN_ERROR,
     INVALID_INPUT
 } TokenCode;
@@ -31,66 +35,378 @@ typedef enum {
 typedef enum {
     HUMAN,
     P1_AUTO,
-    P2_AUTO
+    P2_AUTO,
+    P3_AUTO,
+    P4_AUTO,
+    P5_AUTO
 } PlayerType;
 
+/*
+    A node of the tree of an MCTS player, reached from its parent by making
+    move. Of the visits playouts through the node, wins were won by the
+    player who made the move, a draw counting as half a win, and virtualLoss
+    playouts are still running through it. The children are made once the
+    node is expanded, and an expanded node without children ends the game.
+*/
+typedef struct MctsNode {
+    int move[3];
+    long long visits;
+    double wins;
+    int virtualLoss;
+    bool expanded;
+    int childCount;
+    struct MctsNode* children;
+} MctsNode;
+
+/*
+    The tree an MCTS player keeps between its turns, rooted at the position
+    after its last move, when the game had movesMade moves, and holding
+    nodes nodes.
+*/
+typedef struct {
+    MctsNode* root;
+    long long nodes;
+    int movesMade;
+} MctsTree;
+
 /* 
     Player object that contains its symbol, PlayerType defined above,
     recent move made by this player, and describes whether the player is
-    first player, which is necessary in the Type 2 algorithm. 
+    first player, which is necessary in the Type 2 algorithm. An MCTS player
+    keeps its tree between turns, which is NULL for any other player.
 */
 typedef struct {
     char* symbol;
     PlayerType type;
     int recentMove[2];
     bool firstPlayer;
+    MctsTree* tree;
 } Player;
 
+/* The largest height and width of a board */
+#define MAX_DIMENSION 100000
+
+/* Number of rows and columns of a chunk of the board, one word per row */
+#define CHUNK_SIZE 64
+
+/*
+    A square block of CHUNK_SIZE x CHUNK_SIZE cells of the board stored as two
+    bitboards, where bit n of a row describes column n of the chunk. The
+    occupied plane has a bit set for every cell containing a placement and
+    the owner plane has a bit set when that placement belongs to the second
+    player.
+*/
+typedef struct {
+    uint64_t occupied[CHUNK_SIZE];
+    uint64_t owner[CHUNK_SIZE];
+} Chunk;
+
 /*  
     An object that stores the row - height, and column of the board, and stores
-    information about each placement pointing to the Player object, which is
-    described as 3D array.
+    the placements in chunks that are only allocated once a placement is made
+    in them, so the memory used follows the occupied area of the board. The
+    bands hold a row of chunkCols chunks for each of the chunkRows rows of
+    chunks, where a NULL band or chunk is empty. Of the wholeChunks chunks
+    lying wholly within the board, claimedChunks have been allocated.
+
+    The players array maps the owner bit back to the Player object so the
+    symbol can be used when drawing.
 
-    When drawing the symbol of the player is used, and if there is no placement
-    in a particular coordinate NULL is used as an indication.
+    The rows from changedTop to changedBottom have changed since the board
+    was last drawn, which is empty when changedTop > changedBottom.
 */
 typedef struct {
     int width;
     int height;
-    Player*** grid;
+    int chunkRows;
+    int chunkCols;
+    Chunk*** bands;
+    long long wholeChunks;
+    long long claimedChunks;
+    Player* players[2];
+    int changedTop;
+    int changedBottom;
+    bool displayed;
 } Board;
 
+/*
+    Indicates the four rotations that are possible by the player. It is used
+    for rotation array definition
+*/
+#define POSSIBLE_ROTATION 4
+
+/* The width and height of the square grid every tile is drawn on */
+#define TILE_GRID_SQR_DIM 5
+
+/* Total number of cells in a tile grid */
+#define TILE_GRID_CELLS (TILE_GRID_SQR_DIM * TILE_GRID_SQR_DIM)
+
+/*
+    The compiled layout of a tile in a single rotation. The mask packs the
+    five rows of the tile grid as 5-bit row masks, row r occupying bits 5r to
+    5r + 4 with bit 5r + c set if column c of that row is placeable.
+
+    The bounding box gives the first and last placeable row and column of the
+    grid, and cells lists the placeable positions as row * 5 + col. A tile
+    without any placeable position has an empty box where top > bottom.
+*/
+typedef struct {
+    uint32_t mask;
+    signed char top;
+    signed char bottom;
+    signed char left;
+    signed char right;
+    unsigned char cellCount;
+    unsigned char cells[TILE_GRID_CELLS];
+} TileShape;
+
+/*
+    A tile along with all of its rotations stored next to each other, indexed
+    by the rotation divided by 90. Rotation r has the same shape as rotation
+    sameRotation[r], the lowest rotation with that shape, so a symmetric tile
+    only has its distinct rotations searched. Likewise sameTile is the lowest
+    tile of the tile file with the same shape as this tile.
+*/
+typedef struct {
+    TileShape rotations[POSSIBLE_ROTATION];
+    unsigned char sameRotation[POSSIBLE_ROTATION];
+    int sameTile;
+} Tile;
+
 /*
     Tiles object that loads the tile file and contains information about total 
-    tiles, the current tile index in use, and the Tile grid, which contains 
-    information about the layout of possible placements within the board. This
-    layout is a 4D array.
+    tiles, the current tile index in use, and the list of tiles, which
+    contains information about the layout of possible placements within the
+    board in every rotation. The list is a single block with room for
+    capacity tiles, of which the first total are in use.
 */
 typedef struct {
     int total;
+    int capacity;
     int current;
     int rotationIndex;
-    int**** grid;
+    Tile* list;
 } Tiles;
 
+/*
+    Index of every legal placement of every tile rotation on the board. The
+    candidate centers of a tile range from -2 to height + 1 and -2 to width + 1
+    so they are stored with an offset of two as a rows x cols bitset per tile
+    rotation, each row packed into rowWords 64-bit words.
+
+    Tile rotations with the same shape share a single bitset, so there is a
+    slot for each of the distinct shapes. Rotation r of tile t uses slot 
+    slots[t * 4 + r], whose bitset is rows * rowWords words long, and shapes
+    holds the tile rotation t * 4 + r each slot was made from. The counts hold the number of legal candidates of each slot so the
+    existence of a legal move can be answered without a scan.
+
+    The index follows board, whose tiles are given by tiles. The centers of
+    the last MOVE_INDEX_CHANGES tiles changed on the board are kept in a ring
+    in changes, a row followed by a column, out of the changed tiles changed
+    so far. A slot is only brought up to date when it is looked up, seen
+    being the number of changes each slot has caught up with, so a move does
+    not cost more with every tile added to the library.
+
+    The bitset of each slot is found through bitsets. A copy of an index
+    starts out pointing at the bitsets of the index it was copied from and
+    only copies the bitset of a slot once the slot has to catch up with a
+    change, owned marking the slots it has copied, so a copy costs no more
+    than the slots it looks up. An index that is not a copy holds every
+    bitset in legal and has no owned.
+*/
+typedef struct {
+    int total;
+    int distinct;
+    int rows;
+    int cols;
+    int rowWords;
+    int* slots;
+    int* shapes;
+    uint64_t* legal;
+    uint64_t** bitsets;
+    bool* owned;
+    long long* counts;
+    Board* board;
+    Tiles* tiles;
+    int* changes;
+    long long changed;
+    long long* seen;
+} MoveIndex;
+
+/*
+    The number of legal moves of every distinct tile rotation on the board,
+    kept instead of an index of legal moves when the index would be too
+    large. Rotation r of tile t is counted at counts[t * 4 + r] of the total
+    tile rotations. Counting the whole board can take longer than a move, so
+    the tile rotations are counted in order over several moves: those before
+    ready are counted, and of rotation ready the first rows candidate rows.
+*/
+typedef struct {
+    int total;
+    long long* counts;
+    int ready;
+    int rows;
+} MoveCounts;
+
+/*
+    The orders in which a search visits the possible moves. Type 1 scans every
+    position for a rotation before trying the next rotation, while Type 2 
+    tries every rotation at a position before moving to the next position.
+*/
+typedef enum {
+    SCAN_ROTATION_FIRST,
+    SCAN_POSITION_FIRST
+} ScanOrder;
+
+/*
+    A search for the first legal move of the current tile in a scan order,
+    starting from a position and going either left to right and top to bottom
+    or the opposite when forward is false.
+
+    Once searched the result is kept in found and move as row, column and
+    rotation, so checking whether a move exists and choosing the move share a
+    single traversal of the board.
+*/
+typedef struct {
+    Player* player;
+    ScanOrder order;
+    bool forward;
+    int start[2];
+    bool searched;
+    bool found;
+    int move[3];
+} MoveSearch;
+
+/* The largest number of threads that can be asked for on the command line */
+#define MAX_THREADS 256
+
+/*
+    Options given on the command line along with the usual arguments. A
+    headless run plays the given number of games back to back without
+    displaying the board or the moves, and when seeded the starting tile of
+    every game is picked at random from the seed. A tournament plays the
+    games of every combination of its arguments on the given number of
+    threads. When drawing changes only the rows changed by a move are drawn
+    after the first board. Games are saved in the binary format rather than
+    as text when binarySaves is set. Boards are scanned for moves and MCTS
+    players run their playouts on up to the given number of threads. A
+    searching player takes moveTime milliseconds for every move, and an MCTS
+    player runs the given number of playouts instead when playouts is set.
+    Every move is appended to the journal at the given path when one is
+    given, and a game journaled there before is resumed from it. A perft
+    counts the move sequences of the given depth instead of playing, with
+    every move checked by valid_move rather than the index when naiveMoves
+    is set. The performance counters are reported to the stats path at exit
+    when one is given.
+*/
+typedef struct {
+    bool headless;
+    int games;
+    bool seeded;
+    uint64_t seed;
+    int tournament;
+    bool drawChanges;
+    bool binarySaves;
+    int threads;
+    int moveTime;
+    int playouts;
+    char* journal;
+    int perft;
+    bool naiveMoves;
+    char* stats;
+} Options;
+
+/*
+    A journal the moves of a game are appended to as they are made, of which
+    unsynced moves have not been synchronised to disk yet.
+*/
+typedef struct {
+    FILE* file;
+    int unsynced;
+} Journal;
+
+/*
+    A move as it was made: the row, column and rotation, the tile placed and
+    the turn it was made on, along with the recent moves of the game and of
+    the player from before the move.
+*/
+typedef struct {
+    int move[3];
+    int tile;
+    int turn;
+    int recentMove[2];
+    int playerMove[2];
+} MoveRecord;
+
+/*
+    The moves of a game that can be taken back. Of the count moves in the
+    list, which has room for capacity moves, the first done are on the board
+    while the rest have been taken back and can be made again.
+*/
+typedef struct {
+    MoveRecord* list;
+    int count;
+    int done;
+    int capacity;
+} MoveHistory;
+
+/*
+    Performance counters of the hot paths. Automatic players find their
+    moves with find_move, which counts its searches, the lookups of the index
+    of legal moves and the index words they read, and the candidate centers
+    tested by scans without an index. The words of legal centers worked out
+    by legal_center_run, for scans and for building the index, are counted
+    along with the rows tested and words rewritten as the slots of the index
+    catch up with the changes recorded by update_move_index.
+    Calls of valid_move, which checks the moves of humans, MCTS playouts and
+    naive perfts, are counted with the cells they probed. Then come the moves
+    made by every PlayerType, bytes of the board drawn for display and bytes
+    read from tile files and from saved games and journals. Every counter is
+    a long long.
+*/
+typedef struct {
+    long long moveSearches;
+    long long indexLookups;
+    long long indexWordsScanned;
+    long long candidatesScanned;
+    long long legalRunWords;
+    long long indexRowsTested;
+    long long indexWordsUpdated;
+    long long validMoveCalls;
+    long long validMoveCells;
+    long long moves[P5_AUTO + 1];
+    long long bytesRendered;
+    long long tileBytesRead;
+    long long saveBytesRead;
+} Stats;
+
 /*
     Game object that contains information about two players, the board,
-    contains the tile loaded, the current turn within the players and
-    recent move made by either player used in Type 1 algorithm.
+    contains the tile loaded, the index of legal moves when one is kept, the
+    counts of legal moves kept by a searching player when there is no index,
+    the Zobrist hash of the occupied cells of the board, the
+    options the game is played with, the current turn within the players and
+    recent move made by either player used in Type 1 algorithm. Once the game
+    has ended the winner and the number of moves made are kept. The journal
+    the moves are appended to is NULL unless one was asked for, while the
+    history of moves that can be taken back is always kept.
 */
 typedef struct {
     Player* player1;
     Player* player2;
     Board* gameBoard;
     Tiles* tiles;
+    MoveIndex* moves;
+    MoveCounts* counts;
+    uint64_t hash;
+    Options options;
+    Journal* journal;
+    MoveHistory* history;
     int turn;
     int recentMove[2];
+    int movesMade;
+    Player* winner;
 } Game;
 
-/*
-    Indicates the four rotations that are possible by the player. It is used
-    for rotation array definition
-*/
-#define POSSIBLE_ROTATION 4
 
 #endif
\ No newline at end of file
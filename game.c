@@ -1,4 +1,5 @@
 #include "game.h"
+#include <pthread.h>
 
 /*
     Initiates the game by parsing the arguments given by the user
@@ -18,7 +19,7 @@ int start_game(int argc, char** argv) {
 /*
     Initialises the game with default values for players, game grid,
     tiles and sets the recent move to be invalid value that is not possible
-    by the dimension constraints i.e. -999 till 999
+    by the dimension constraints i.e. up to MAX_DIMENSION
 
     @returns the game state to be manipulated by game functions
 */
@@ -29,23 +30,41 @@ Game* initialise_game(void) {
     newGame->player2 = initialise_player(false);
     // Initialises game grid and tiles
     newGame->gameBoard = initialise_grid();
+    // The board maps its owner bits back to the players when drawing
+    newGame->gameBoard->players[0] = newGame->player1;
+    newGame->gameBoard->players[1] = newGame->player2;
     newGame->tiles = initialise_tile_list();
+    // The index of legal moves is built once the board is known
+    newGame->moves = NULL;
+    newGame->counts = NULL;
+    newGame->hash = 0;
+    newGame->journal = NULL;
+    newGame->history = calloc(1, sizeof(MoveHistory));
     // Assigns value that is not possible by dimension constraints
     newGame->recentMove[0] = INT_MIN;
     newGame->recentMove[1] = INT_MIN;
     // Indicates first player
     newGame->turn = 0;
+    newGame->movesMade = 0;
+    newGame->winner = NULL;
+    initialise_options(&newGame->options);
     return newGame;
 }
 
 /*
-    Frees the memory allocated for the entire game including tiles, grids,
+    Frees the memory allocated for the entire game including tiles, the index
+    and counts of legal moves, the journal, the history of moves, grids,
     players and the actual game
 
     @param gameContent contains the state of the game and its dependencies
 */
 void free_game(Game* gameContent) {
     free_tiles(gameContent->tiles);
+    free_move_index(gameContent->moves);
+    free_move_counts(gameContent->counts);
+    close_journal(gameContent->journal);
+    free(gameContent->history->list);
+    free(gameContent->history);
     free_grid(gameContent->gameBoard);
     free_players(gameContent);
     free(gameContent);
@@ -64,11 +83,49 @@ void change_turn(Game* game) {
     game->turn = (++turn) % 2;
 }
 
+/*
+    Records a move on the history of the game before it is placed, so it can
+    be taken back. Making the move the history would make again next keeps
+    the moves taken back after it, while any other move drops them.
+
+    @param game contains the history, before the move is placed
+    @param command contains the coordinate and rotation of the move
+    @param playing the player who makes the move
+*/
+static void record_move(Game* game, int* command, Player* playing) {
+    MoveHistory* history = game->history;
+    if (history->done < history->count) {
+        MoveRecord* next = &history->list[history->done];
+        if (next->tile == game->tiles->current && next->turn == game->turn &&
+                memcmp(next->move, command, sizeof(next->move)) == 0) {
+            history->done++;
+            return;
+        }
+    }
+    if (history->done == history->capacity) {
+        history->capacity = history->capacity == 0 ? HISTORY_MOVES : 
+                history->capacity * 2;
+        history->list = realloc(history->list, 
+                sizeof(MoveRecord) * history->capacity);
+    }
+    MoveRecord* record = &history->list[history->done++];
+    memcpy(record->move, command, sizeof(record->move));
+    record->tile = game->tiles->current;
+    record->turn = game->turn;
+    memcpy(record->recentMove, game->recentMove, sizeof(game->recentMove));
+    memcpy(record->playerMove, playing->recentMove, 
+            sizeof(playing->recentMove));
+    history->count = history->done;
+}
+
 /*
     Places the move in the given coordinate by reading the content of tiles,
     and placing the content based on who is playing. It assumes that the given
     coordinate is valid and places values, a helper function for valid_move
-    function.
+    function. Each row of the tile is written to the board as a single mask,
+    the hash of the board and any index or counts of legal moves follow the
+    cells placed, and the move is recorded on the history of the game and
+    appended to its journal when it has one.
 
     @param command contains the coordinate and rotation input from the user
     @param playing the player who is currently in their turn
@@ -78,53 +135,150 @@ void change_turn(Game* game) {
 void place_move(int* command, Player* playing, Game* game, Tiles* tiles) { 
     int centerY = command[0];
     int centerX = command[1];
+    if (game->history != NULL) {
+        record_move(game, command, playing);
+    }
 
     int offset = TILE_GRID_SQR_DIM / 2;
     int currentIndex = tiles->current;
     
     // Each rotated tile is stored in the memory
     int rotationIndex = command[2] / 90;
-    int** currentTile = tiles->grid[rotationIndex][currentIndex];
+    TileShape* shape = &tiles->list[currentIndex].rotations[rotationIndex];
     
     Board* grid = game->gameBoard;
-    Player*** board = grid->grid;
-
-    // Iterates from the top of the tile in the perspective of the
-    // board, the centerY - offset to the bottom of the tile in the
-    // perspective of the board.
-    for (int y = centerY - offset; y <= centerY + offset; y++) {
-        // Getting the vertical index from the tiles perspective
-        int tileY = y - centerY + offset;
-        // Iterates from the left most corner to the other end
-        for (int x = centerX - offset; x <= centerX + offset; x++) {
-            // Getting the horizontal index from the tiles perspective
-            int tileX = x - centerX + offset;
-            // If the tile at that coordinate exist then place the player
-            if (currentTile[tileY][tileX]) {
-                board[y][x] = playing;
-            }
-        } 
+    if (game->counts != NULL && shape->cellCount > 0) {
+        update_move_counts(game->counts, grid, tiles, centerY, centerX, -1);
+    }
+
+    // Iterates from the top of the tile in the perspective of the board to
+    // the bottom of the tile, placing the whole row of the tile at once
+    for (int tileY = shape->top; tileY <= shape->bottom; tileY++) {
+        uint64_t rowMask = 
+                shape->mask >> (tileY * TILE_GRID_SQR_DIM) & TILE_ROW_BITS;
+        if (rowMask != 0) {
+            grid_set_row_bits(grid, centerY - offset + tileY, 
+                    centerX - offset, rowMask, playing);
+        }
     }
     
+    game->hash ^= grid_shape_key(shape, centerY, centerX);
+    // Only the legal moves around the placed tile can have changed
+    if (game->moves != NULL && shape->cellCount > 0) {
+        update_move_index(game->moves, centerY, centerX);
+    }
+    if (game->counts != NULL && shape->cellCount > 0) {
+        update_move_counts(game->counts, grid, tiles, centerY, centerX, 1);
+    }
+    
+    if (game->journal != NULL) {
+        journal_move(game, command, playing);
+    }
+
     // Update to the recent move of the game and the player for its use in
     // algorithms
+    game->movesMade++;
     game->recentMove[0] = centerY; 
     playing->recentMove[0] = centerY;
     game->recentMove[1] = centerX;
     playing->recentMove[1] = centerX;
 }
 
+/*
+    Takes back the last move on the history of the game, clearing only the
+    cells of its tile and giving back the tile, turn and recent moves from
+    before it. The trees of MCTS players no longer follow the game so they
+    are dropped, and a journaled game records the move being taken back.
+
+    @param game contains the state of the game and its history
+    @returns whether there was a move to take back
+*/
+bool undo_move(Game* game) {
+    MoveHistory* history = game->history;
+    if (history == NULL || history->done == 0) {
+        return false;
+    }
+    MoveRecord* record = &history->list[--history->done];
+    Player* playing = record->turn == 0 ? game->player1 : game->player2;
+    TileShape* shape = 
+            &game->tiles->list[record->tile].rotations[record->move[2] / 90];
+    int offset = TILE_GRID_SQR_DIM / 2;
+    bool changes = shape->cellCount > 0;
+    if (game->counts != NULL && changes) {
+        update_move_counts(game->counts, game->gameBoard, game->tiles,
+                record->move[0], record->move[1], -1);
+    }
+    for (int tileY = shape->top; tileY <= shape->bottom; tileY++) {
+        uint64_t rowMask = 
+                shape->mask >> (tileY * TILE_GRID_SQR_DIM) & TILE_ROW_BITS;
+        if (rowMask != 0) {
+            grid_clear_row_bits(game->gameBoard, 
+                    record->move[0] - offset + tileY,
+                    record->move[1] - offset, rowMask);
+        }
+    }
+    game->hash ^= grid_shape_key(shape, record->move[0], record->move[1]);
+    if (game->moves != NULL && changes) {
+        update_move_index(game->moves, record->move[0], record->move[1]);
+    }
+    if (game->counts != NULL && changes) {
+        update_move_counts(game->counts, game->gameBoard, game->tiles,
+                record->move[0], record->move[1], 1);
+    }
+
+    game->tiles->current = record->tile;
+    game->turn = record->turn;
+    game->movesMade--;
+    memcpy(game->recentMove, record->recentMove, sizeof(game->recentMove));
+    memcpy(playing->recentMove, record->playerMove, 
+            sizeof(playing->recentMove));
+    for (int each = 0; each < 2; each++) {
+        Player* player = each == 0 ? game->player1 : game->player2;
+        free_mcts_tree(player->tree);
+        player->tree = NULL;
+    }
+    if (game->journal != NULL) {
+        journal_undo(game);
+    }
+    return true;
+}
+
+/*
+    Makes again the last move taken back from the history of the game,
+    placing only the cells of its tile.
+
+    @param game contains the state of the game and its history
+    @returns whether there was a move to make again
+*/
+bool redo_move(Game* game) {
+    MoveHistory* history = game->history;
+    if (history == NULL || history->done == history->count) {
+        return false;
+    }
+    MoveRecord* record = &history->list[history->done];
+    Player* playing = record->turn == 0 ? game->player1 : game->player2;
+    int command[3];
+    memcpy(command, record->move, sizeof(command));
+    game->tiles->current = record->tile;
+    game->turn = record->turn;
+    place_move(command, playing, game, game->tiles);
+    change_turn(game);
+    change_tiles(game);
+    return true;
+}
+
 /*
     Validates whether the given coordinate and current tile can be placed on 
-    the board.
+    the board. The bounding box of the tile is tested against the board
+    bounds and then each row of the tile is tested against the occupied cells
+    of the board with a single mask.
 
     @param command contains the coordinate and rotation input from the player
-    @param playing who is currently playing the game
     @param grid the board that contains the placements
     @param tiles containing tiles and the current tile
     @returns whether the move was valid by the player
 */
-bool valid_move(int* command, Player* playing, Board* grid, Tiles* tiles) {
+bool valid_move(int* command, Board* grid, Tiles* tiles) {
     int centerY = command[0];
     int centerX = command[1];
     // Getting the mid-point of the tile grid since it is always a square
@@ -132,25 +286,30 @@ bool valid_move(int* command, Player* playing, Board* grid, Tiles* tiles) {
     // Getting the rotation index
     int rotationIndex = command[2] / 90;
     int currentIndex = tiles->current;
-    int** currentTile = tiles->grid[rotationIndex][currentIndex];
-    
-    int maxWidth = grid->width;
-    int maxHeight = grid->height;
-    
-    Player*** board = grid->grid;
-     
-    for (int y = centerY - offset; y <= centerY + offset; y++) {
-        int tileY = y - centerY + offset;
-        for (int x = centerX - offset; x <= centerX + offset; x++) {
-            int tileX = x - centerX + offset;
-            // If any placeable points in the tile is outside of the board 
-            // bounds or, the board already contains the player then the move 
-            // is invalid
-            if (currentTile[tileY][tileX] && (y < 0 || y >= maxHeight ||
-                    x < 0 || x >= maxWidth || board[y][x] != NULL)) {
-                return false;
-            }
+    TileShape* shape = &tiles->list[currentIndex].rotations[rotationIndex];
+    STATS_ADD(validMoveCalls, 1);
 
+    // A tile without any placeable position fits anywhere
+    if (shape->cellCount == 0) {
+        return true;
+    }
+    // The board position of the top left corner of the tile grid
+    long long top = (long long) centerY - offset;
+    long long left = (long long) centerX - offset;
+    // If any placeable points in the tile is outside of the board bounds then
+    // the move is invalid
+    if (top + shape->top < 0 || top + shape->bottom >= grid->height ||
+            left + shape->left < 0 || left + shape->right >= grid->width) {
+        return false;
+    }
+    // If the board already contains a player in any placeable point then the
+    // move is invalid
+    for (int tileY = shape->top; tileY <= shape->bottom; tileY++) {
+        uint64_t rowMask = 
+                shape->mask >> (tileY * TILE_GRID_SQR_DIM) & TILE_ROW_BITS;
+        STATS_ADD(validMoveCells, __builtin_popcountll(rowMask));
+        if (grid_row_bits(grid, (int) top + tileY, (int) left) & rowMask) {
+            return false;
         }
     }
     return true;
@@ -190,65 +349,544 @@ void update_position_algorithm_one(int* row, int boardHeight, int* col,
 }
 
 /*
-    Type 1 algorithm for automatic player that checks every possible
-    combination to find a valid one.
-    The algorithm firstly iterates through each possible rotation and for
-    each rotation checks all possible moves resetting as defined in above
-    function until reaching the initial move.
+    Gets the first position within the candidate centers, -2 to height + 1
+    and -2 to width + 1, that a scan starting at the given position visits.
+    The scan can start outside of the candidates, e.g. at the initial position
+    of the second Type 2 player, but every candidate center is visited once
+    before the scan wraps around.
 
-    @param game contains the state of the game to get information about turn
-    and board, to change 
-    @param totalPlayers contains both the player objects
+    @param board the board on which the scan is made
+    @param row the row where the scan starts
+    @param col the column where the scan starts
+    @param forward whether the scan goes left to right and top to bottom or
+    right to left and bottom to top
+    @returns the number of the first candidate visited by the scan, counting
+    the candidates row by row from the top left
 */
-void algorithm_one(Game* game, Player** totalPlayers) {
-    int turn = game->turn;
-    int recentMove[2] = {
-        game->recentMove[0],
-        game->recentMove[1] 
+static long long first_candidate(Board* board, int row, int col,
+        bool forward) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    long long candidateRow = (long long) row + offset;
+    long long candidateCol = (long long) col + offset;
+    long long rows = board->height + 2 * offset;
+    long long cols = board->width + 2 * offset;
+    // Scans wrap to the first or last candidate from rows outside the board
+    if (candidateRow < 0 || candidateRow >= rows) {
+        return forward ? 0 : rows * cols - 1;
+    }
+    if (forward) {
+        if (candidateCol < 0) {
+            return candidateRow * cols;
+        } else if (candidateCol >= cols) {
+            return candidateRow + 1 < rows ? (candidateRow + 1) * cols : 0;
+        }
+    } else {
+        if (candidateCol >= cols) {
+            return candidateRow * cols + cols - 1;
+        } else if (candidateCol < 0) {
+            return candidateRow > 0 ? candidateRow * cols - 1 : 
+                    rows * cols - 1;
+        }
+    }
+    return candidateRow * cols + candidateCol;
+}
+
+/*
+    Finds the first legal move of the search by looking up the index of legal
+    moves instead of testing every position.
+
+    @param game contains the index, the board and the current tile
+    @param search the search whose move is found
+    @returns whether a legal move was found
+*/
+static bool indexed_search(Game* game, MoveSearch* search) {
+    MoveIndex* index = game->moves;
+    int tile = game->tiles->current;
+    int offset = TILE_GRID_SQR_DIM / 2;
+    bool forward = search->forward;
+
+    long long first = first_candidate(game->gameBoard, search->start[0],
+            search->start[1], forward);
+    long long total = (long long) index->rows * index->cols;
+    long long best = -1;
+    long long bestDistance = total;
+    int bestRotation = 0;
+    unsigned char* sameRotation = game->tiles->list[tile].sameRotation;
+    for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+        // A rotation with the same shape as a lower one finds the same move
+        if (sameRotation[rotation] != rotation) {
+            continue;
+        }
+        long long found = move_index_next(index, tile, rotation, first, 
+                forward);
+        if (found < 0) {
+            continue;
+        }
+        // The rotation found nearest to the start wins, and ties go to the
+        // lower rotation as it is tried first
+        long long distance = forward ? found - first : first - found;
+        distance = (distance + total) % total;
+        if (distance < bestDistance) {
+            best = found;
+            bestDistance = distance;
+            bestRotation = rotation;
+        }
+        if (search->order == SCAN_ROTATION_FIRST) {
+            break;
+        }
+    }
+    if (best < 0) {
+        return false;
+    }
+    search->move[0] = best / index->cols - offset;
+    search->move[1] = best % index->cols - offset;
+    search->move[2] = bestRotation * 90;
+    return true;
+}
+
+/*
+    Widens the candidate rows and columns of a scan to cover the centers at
+    which the given rotation of the tile lies wholly on the board. Any other
+    center puts a placeable cell of the tile off the board, so it is never a
+    legal move and the scan does not need to test it.
+
+    @param board the board on which the scan is made
+    @param shape the rotation of the tile being scanned
+    @param bounds the first and last candidate row followed by the first and
+    last candidate column, widened in place
+*/
+static void widen_candidate_bounds(Board* board, TileShape* shape,
+        int bounds[4]) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    // A candidate is the center moved by offset, and the tile grid starts
+    // offset cells above and left of the center
+    int limits[4] = {
+        2 * offset - shape->top,
+        board->height - 1 + 2 * offset - shape->bottom,
+        2 * offset - shape->left,
+        board->width - 1 + 2 * offset - shape->right
     };
+    for (int each = 0; each < 4; each += 2) {
+        if (limits[each] > limits[each + 1]) {
+            continue;
+        }
+        if (limits[each] < bounds[each]) {
+            bounds[each] = limits[each];
+        }
+        if (limits[each + 1] > bounds[each + 1]) {
+            bounds[each + 1] = limits[each + 1];
+        }
+    }
+}
+
+/*
+    Finds the first legal center of a candidate row between two candidate
+    columns in scan order. The columns are tested a run of words at a time
+    by legal_center_run. When several rotations are tried, the lowest one
+    legal at the first column found is chosen, as the rotations of a position
+    are tried in order.
+
+    @param board the board on which the scan is made
+    @param tile the tile being placed
+    @param rotations the rotations tried, bit r set for rotation r
+    @param row the candidate row
+    @param firstCol the first candidate column of the row to be tested
+    @param lastCol the last candidate column of the row to be tested
+    @param forward whether the columns are scanned left to right
+    @param move set to the row, column and rotation of the move found
+    @returns whether a legal center was found
+*/
+static bool scan_candidate_row(Board* board, Tile* tile, unsigned rotations,
+        int row, int firstCol, int lastCol, bool forward, int move[3]) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int runCols = LEGAL_RUN_WORDS * WORD_BITS;
+    uint64_t legal[POSSIBLE_ROTATION][LEGAL_RUN_WORDS];
+    uint64_t any[LEGAL_RUN_WORDS];
+    while (firstCol <= lastCol) {
+        // The run of columns nearest to the start of the scan
+        int runFirst = forward ? firstCol : lastCol - runCols + 1;
+        int runLast = forward ? firstCol + runCols - 1 : lastCol;
+        runFirst = runFirst > firstCol ? runFirst : firstCol;
+        runLast = runLast < lastCol ? runLast : lastCol;
+        int words = (runLast - runFirst) / WORD_BITS + 1;
+        memset(any, 0, sizeof(uint64_t) * words);
+        for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+            if (!(rotations & (1u << rotation))) {
+                continue;
+            }
+            STATS_ADD(candidatesScanned, runLast - runFirst + 1);
+            legal_center_run(board, &tile->rotations[rotation], 
+                    row - offset, runFirst - offset, words, legal[rotation]);
+            for (int word = 0; word < words; word++) {
+                any[word] |= legal[rotation][word];
+            }
+        }
+        // Clearing the centers past the end of the run
+        int spare = words * WORD_BITS - (runLast - runFirst + 1);
+        any[words - 1] &= ~(uint64_t) 0 >> spare;
+
+        for (int each = 0; each < words; each++) {
+            int word = forward ? each : words - 1 - each;
+            if (any[word] == 0) {
+                continue;
+            }
+            int bit = forward ? __builtin_ctzll(any[word]) :
+                    WORD_BITS - 1 - __builtin_clzll(any[word]);
+            int rotation = 0;
+            while (!(rotations & (1u << rotation)) || 
+                    !(legal[rotation][word] >> bit & 1)) {
+                rotation++;
+            }
+            move[0] = row - offset;
+            move[1] = runFirst + word * WORD_BITS + bit - offset;
+            move[2] = rotation * 90;
+            return true;
+        }
+        if (forward) {
+            firstCol = runLast + 1;
+        } else {
+            lastCol = runFirst - 1;
+        }
+    }
+    return false;
+}
+
+/*
+    A pass of the board scan shared by the threads making it. The visits of
+    the candidate rows, in scan order, are handed out in blocks through
+    nextVisit. best is the lowest scan position of a legal move found so
+    far, so every thread stops once the rows it has left cannot beat it.
+*/
+typedef struct {
+    Board* board;
+    Tile* tile;
+    unsigned rotations;
+    int bounds[4];
+    int rows;
+    int cols;
+    int startRow;
+    int startCol;
+    bool forward;
+    int nextVisit;
+    long long best;
+} ScanPass;
+
+/*
+    A single thread of a pass of the board scan along with the first move it
+    has found, found being the scan position of the move or -1.
+*/
+typedef struct {
+    ScanPass* pass;
+    long long found;
+    int move[3];
+} ScanWorker;
+
+/*
+    Tests the candidate row of a visit of the scan. The row where the scan
+    starts is visited twice, from the start column onwards and again up to
+    the start column once the scan has wrapped around.
+
+    @param pass the pass of the scan
+    @param visit the number of rows visited before this one in scan order
+    @param move set to the row, column and rotation of the move found
+    @returns whether a legal move was found in the row
+*/
+static bool scan_visit(ScanPass* pass, int visit, int move[3]) {
+    int rows = pass->rows;
+    int step = pass->forward ? 1 : -1;
+    int row = ((pass->startRow + step * visit) % rows + rows) % rows;
+    if (row < pass->bounds[0] || row > pass->bounds[1]) {
+        return false;
+    }
+    int startCol = pass->startCol;
+    int firstCol = pass->bounds[2];
+    int lastCol = pass->bounds[3];
+    if (visit == 0 && pass->forward) {
+        firstCol = startCol > firstCol ? startCol : firstCol;
+    } else if (visit == 0) {
+        lastCol = startCol < lastCol ? startCol : lastCol;
+    } else if (visit == rows && pass->forward) {
+        lastCol = startCol - 1 < lastCol ? startCol - 1 : lastCol;
+    } else if (visit == rows) {
+        firstCol = startCol + 1 > firstCol ? startCol + 1 : firstCol;
+    }
+    return scan_candidate_row(pass->board, pass->tile, pass->rotations, row,
+            firstCol, lastCol, pass->forward, move);
+}
+
+/*
+    Scans blocks of rows of a pass until every row has been handed out or
+    the rows left come after a move already found. The first move found in
+    a row is the first of the row, and rows are handed out in scan order, so
+    the lowest position found by any thread is the move of a serial scan.
+
+    @param worker the worker scanning the pass
+*/
+static void scan_blocks(ScanWorker* worker) {
+    ScanPass* pass = worker->pass;
+    long long cols = pass->cols;
+    worker->found = -1;
+    while (true) {
+        int visit = __atomic_fetch_add(&pass->nextVisit, PARALLEL_SCAN_ROWS,
+                __ATOMIC_RELAXED);
+        int last = visit + PARALLEL_SCAN_ROWS - 1;
+        last = last < pass->rows ? last : pass->rows;
+        for (; visit <= last; visit++) {
+            if (visit * cols > __atomic_load_n(&pass->best, 
+                    __ATOMIC_RELAXED)) {
+                return;
+            }
+            if (!scan_visit(pass, visit, worker->move)) {
+                continue;
+            }
+            // Positions count along the row in the direction of the scan
+            int col = worker->move[1] + TILE_GRID_SQR_DIM / 2;
+            worker->found = visit * cols + (pass->forward ? col : 
+                    cols - 1 - col);
+            long long best = __atomic_load_n(&pass->best, __ATOMIC_RELAXED);
+            while (worker->found < best && 
+                    !__atomic_compare_exchange_n(&pass->best, &best, 
+                    worker->found, false, __ATOMIC_RELAXED, 
+                    __ATOMIC_RELAXED)) {
+            }
+            return;
+        }
+        if (visit > pass->rows) {
+            return;
+        }
+    }
+}
+
+/*
+    Runs a worker of a pass of the board scan, keeping the counts of the
+    thread once it is done.
 
+    @param data the worker scanning the pass
+    @returns nothing
+*/
+static void* scan_worker(void* data) {
+    scan_blocks(data);
+    STATS_FLUSH();
+    return NULL;
+}
+
+/*
+    Makes a pass of the board scan, on the given number of threads when the
+    candidates tested are numerous enough to be worth splitting.
+
+    @param pass the pass to be made
+    @param threads the largest number of threads the pass is made on
+    @param move set to the row, column and rotation of the move found
+    @returns whether a legal move was found
+*/
+static bool scan_pass(ScanPass* pass, int threads, int move[3]) {
+    long long cells = (long long) (pass->bounds[1] - pass->bounds[0] + 1) *
+            (pass->bounds[3] - pass->bounds[2] + 1);
+    if (cells < PARALLEL_SCAN_CELLS || pass->bounds[1] < pass->bounds[0]) {
+        threads = 1;
+    }
+    pass->nextVisit = 0;
+    pass->best = LLONG_MAX;
+    ScanWorker workers[MAX_THREADS];
+    pthread_t handles[MAX_THREADS];
+    for (int each = 0; each < threads; each++) {
+        workers[each].pass = pass;
+    }
+    // The calling thread scans along with the others
+    for (int each = 1; each < threads; each++) {
+        pthread_create(&handles[each], NULL, scan_worker, &workers[each]);
+    }
+    scan_worker(&workers[0]);
+    for (int each = 1; each < threads; each++) {
+        pthread_join(handles[each], NULL);
+    }
+    for (int each = 0; each < threads; each++) {
+        if (workers[each].found == pass->best) {
+            memcpy(move, workers[each].move, sizeof(workers[each].move));
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Finds the first legal move of the search by testing every candidate
+    position and rotation in the scan order, used when there is no index.
+    Rows and columns where none of the rotations being tried fit on the
+    board are skipped, which keeps the scan order and so the move found, and
+    each row is tested many columns at a time by scan_candidate_row. Large
+    boards are scanned on the number of threads given in the options.
+
+    @param game contains the board and the current tile
+    @param search the search whose move is found
+    @returns whether a legal move was found
+*/
+static bool scanned_search(Game* game, MoveSearch* search) {
     Board* board = game->gameBoard;
     Tiles* tiles = game->tiles;
-    Player* currentPlayer = totalPlayers[turn];
-    
-    int boardWidth = board->width;
-    int boardHeight = board->height;
+    Tile* tile = &tiles->list[tiles->current];
+    int offset = TILE_GRID_SQR_DIM / 2;
+    ScanPass pass;
+    pass.board = board;
+    pass.tile = tile;
+    pass.rows = board->height + 2 * offset;
+    pass.cols = board->width + 2 * offset;
+    pass.forward = search->forward;
+    long long first = first_candidate(board, search->start[0], 
+            search->start[1], search->forward);
+    pass.startRow = first / pass.cols;
+    pass.startCol = first % pass.cols;
+    // Type 1 goes through every position once per rotation while Type 2 goes
+    // through the positions once trying every rotation at each
+    bool rotationFirst = search->order == SCAN_ROTATION_FIRST;
+    int passes = rotationFirst ? POSSIBLE_ROTATION : 1;
+    // A rotation with the same shape as a lower one has already been tried
+    // at every position, so only the distinct rotations are tested
+    unsigned char* sameRotation = tile->sameRotation;
 
-    // If no move has been made yet, indicated by the minimum of the integer
-    // type
-    if (recentMove[0] == INT_MIN && recentMove[1] == INT_MIN) {
-        recentMove[0] = -2;
-        recentMove[1] = -2;
+    for (int each = 0; each < passes; each++) {
+        if (rotationFirst && sameRotation[each] != each) {
+            continue;
+        }
+        int bounds[4] = {pass.rows, -1, pass.cols, -1};
+        pass.rotations = 0;
+        for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+            if ((!rotationFirst || rotation == each) &&
+                    sameRotation[rotation] == rotation) {
+                widen_candidate_bounds(board, &tile->rotations[rotation],
+                        bounds);
+                pass.rotations |= 1u << rotation;
+            }
+        }
+        memcpy(pass.bounds, bounds, sizeof(bounds));
+        if (scan_pass(&pass, game->options.threads, search->move)) {
+            return true;
+        }
     }
+    return false;
+}
+
+/*
+    Prepares a search for the first legal move of the current tile. 
 
+    @param search the search to be prepared
+    @param player the player that would make the move
+    @param order the order in which positions and rotations are tried
+    @param forward whether the scan goes left to right and top to bottom or
+    right to left and bottom to top
+    @param row the row where the scan starts
+    @param col the column where the scan starts
+*/
+void prepare_search(MoveSearch* search, Player* player, ScanOrder order, 
+        bool forward, int row, int col) {
+    search->player = player;
+    search->order = order;
+    search->forward = forward;
+    search->start[0] = row;
+    search->start[1] = col;
+    search->searched = false;
+    search->found = false;
+}
+
+/*
+    Prepares the search a player makes before their turn. Type 1 scans from
+    the recent move of the game, Type 2 scans from the recent move of the
+    player in the direction given by whether they are the first player, and
+    a human is checked as if they were a first Type 2 player.
+
+    @param game contains the recent move of the game and the board
+    @param player the player whose turn it is
+    @param search the search to be prepared
+*/
+void prepare_player_search(Game* game, Player* player, MoveSearch* search) {
+    Board* board = game->gameBoard;
+    bool typeOne = player->type == P1_AUTO;
+    int* recentMove = typeOne ? game->recentMove : player->recentMove;
+    bool forward = player->type != P2_AUTO || player->firstPlayer;
     int row = recentMove[0];
     int col = recentMove[1];
-    int theta = 0;
-
-    //Change theta by 90 until the new theta is same as the current theta
-    do {
-        // Change position until the new move is same as the current move
-        do {
-            int command[3] = {
-                row,
-                col,
-                theta
-            };
-            if (valid_move(command, currentPlayer, board, tiles)) {
-                place_move(command, currentPlayer, game, tiles);
-                algorithm_output(command, currentPlayer);
-                change_turn(game);
-                change_tiles(game);
-                return;
-            }
-            
-            update_position_algorithm_one(&row, boardHeight, &col, boardWidth);
-    
-        } while (row != recentMove[0] || col != recentMove[1]);
-        // Change theta by 90
-        theta += 90;
-    } while (theta <= 270);
 
+    // If no move has been made yet, indicated by the minimum of the integer
+    // type
+    if (row == INT_MIN && col == INT_MIN) {
+        if (forward) {
+            row = -2;
+            col = -2;
+        } else {
+            row = board->width + 2;
+            col = board->height + 2;
+        }
+    }
+    prepare_search(search, player, typeOne ? SCAN_ROTATION_FIRST : 
+            SCAN_POSITION_FIRST, forward, row, col);
+}
+
+/*
+    Finds the first legal move of the current tile in the order of the
+    search. Both the index of legal moves, when kept, and the scan of every
+    position give the same move. The result is kept in the search so it is
+    only searched once until the search is prepared again.
+
+    @param game contains the board, tiles and index of legal moves
+    @param search the search whose move is found
+    @returns whether there is any legal move
+*/
+bool find_move(Game* game, MoveSearch* search) {
+    if (search->searched) {
+        return search->found;
+    }
+    Tiles* tiles = game->tiles;
+    search->searched = true;
+    STATS_ADD(moveSearches, 1);
+    // A tile without any placeable position fits at the very first position
+    if (tiles->list[tiles->current].rotations[0].cellCount == 0) {
+        search->move[0] = search->start[0];
+        search->move[1] = search->start[1];
+        search->move[2] = 0;
+        search->found = true;
+    } else if (game->moves != NULL) {
+        search->found = indexed_search(game, search);
+    } else {
+        search->found = scanned_search(game, search);
+    }
+    return search->found;
+}
+
+/*
+    Makes the move found by the search for an automatic player, displays the
+    move unless the game is headless and moves on to the next turn and tile.
+
+    @param game contains the state of the game to be changed
+    @param search the search that has found a legal move
+*/
+void play_search_move(Game* game, MoveSearch* search) {
+    place_move(search->move, search->player, game, game->tiles);
+    STATS_ADD(moves[search->player->type], 1);
+    if (!game->options.headless) {
+        algorithm_output(search->move, search->player);
+    }
+    change_turn(game);
+    change_tiles(game);
+}
+
+/*
+    Type 1 algorithm for automatic player that checks every possible
+    combination to find a valid one.
+    The algorithm firstly iterates through each possible rotation and for
+    each rotation checks all possible moves starting from the recent move of
+    the game, as defined in update_position_algorithm_one, until reaching the
+    initial move.
+
+    @param game contains the state of the game to get information about turn
+    and board, to change 
+    @param totalPlayers contains both the player objects
+*/
+void algorithm_one(Game* game, Player** totalPlayers) {
+    MoveSearch search;
+    prepare_player_search(game, totalPlayers[game->turn], &search);
+    if (find_move(game, &search)) {
+        play_search_move(game, &search);
+    }
 }
 
 /*
@@ -308,123 +946,59 @@ void update_position_algorithm_two(int* row, int boardHeight, int* col,
     @param currentPlayer the automatic player Type 2
 */
 void algorithm_two(Game* game, Player* currentPlayer) {
-    int recentMove[2] = {
-        (currentPlayer->recentMove[0]),
-        (currentPlayer->recentMove[1])
-    };
-
-    bool firstPlayer = currentPlayer->firstPlayer;
-    Board* board = game->gameBoard;
-    Tiles* tiles = game->tiles;    
-
-    int boardWidth = board->width;
-    int boardHeight = board->height;
-    
-    // Implement second player only
-    if (recentMove[0] == INT_MIN && recentMove[1] == INT_MIN) {
-        if (firstPlayer) {
-            recentMove[0] = -2;
-            recentMove[1] = -2;
-        } else {
-            recentMove[0] = boardWidth + 2;
-            recentMove[1] = boardHeight + 2; 
-        }
+    MoveSearch search;
+    prepare_player_search(game, currentPlayer, &search);
+    if (find_move(game, &search)) {
+        play_search_move(game, &search);
     }
-    
-    int row = recentMove[0];
-    int col = recentMove[1];
-    
-    do {
-        int theta = 0;
-        do {
-            int command[3] = {
-                row,
-                col, 
-                theta
-            };
-            if (valid_move(command, currentPlayer, board, tiles)) {
-                place_move(command, currentPlayer, game, tiles);
-                algorithm_output(command, currentPlayer);
-                change_turn(game);
-                change_tiles(game);
-                return;
-            }
-            theta += 90;
-        } while (theta <= 270);
-
-        update_position_algorithm_two(&row, boardHeight, &col, boardWidth, 
-                firstPlayer);
-    } while (row != recentMove[0] || col != recentMove[1]);
 }
 
 /*
     Checks whether there exist any possible move by the current player
-    This player can either be automated or human.
+    This player can either be automated or human, and the search is made in
+    the same order as a first Type 2 player.
 
     @param game contains the board, and tiles
     @param currentPlayer the player to validate placements in the board
     @returns whether there are any possible moves that can be made
 */
 bool check_possible_move(Game* game, Player* currentPlayer) {
-    int recentMove[2] = {
-        currentPlayer->recentMove[0],
-        currentPlayer->recentMove[1]
-    };
-
-    Board* board = game->gameBoard;
-    Tiles* tiles = game->tiles;
-
-    int boardWidth = board->width;
-    int boardHeight = board->height;
-
+    int* recentMove = currentPlayer->recentMove;
+    MoveSearch search;
+    // Every tile fits within a whole chunk that has never had a placement,
+    // so the board does not have to be scanned
+    if (game->moves == NULL && grid_has_empty_chunk(game->gameBoard)) {
+        return true;
+    }
     // Assuming the current player is first player to search comprehensively
     if (recentMove[0] == INT_MIN && recentMove[1] == INT_MIN) {
-        recentMove[0] = -2;
-        recentMove[1] = -2;
+        prepare_search(&search, currentPlayer, SCAN_POSITION_FIRST, true, 
+                -2, -2);
+    } else {
+        prepare_search(&search, currentPlayer, SCAN_POSITION_FIRST, true,
+                recentMove[0], recentMove[1]);
     }
-
-    int row = recentMove[0];
-    int col = recentMove[1];
-    
-    // Same as algorithm type 2 implementation
-    do {
-        int theta = 0;
-        do {
-            int command[3] = {
-                row, 
-                col, 
-                theta
-            };
-            
-            if (valid_move(command, currentPlayer, board, tiles)) {
-                return true;
-            }
-
-            theta += 90;
-        } while (theta <= 270);
-        
-        update_position_algorithm_two(&row, boardHeight, &col, boardWidth, 
-                true);
-  
-    } while (row != recentMove[0] || col != recentMove[1]);
-    
-    return false;
+    return find_move(game, &search);
 }
 
 /*
     A main loop that continues to iterate unless input ended voluntarily or
     the game has ended. It takes human input, calls the automated algorithm,
     and takes decision on action based on the player type. E.g. displaying
-    tiles if the player is a human.
+    tiles if the player is a human. Nothing is displayed in a headless game.
 
     @param game contains the player, tile and board object enabling 
     @returns whether the game has been ended or stopped voluntarily by the user
 */
-ErrorCode game_loop(Game* game) {
+ErrorCode play_game(Game* game) {
     Player* players[2] = {
         game->player1,
         game->player2
     };
+    bool headless = game->options.headless;
+    // Builds the index of legal moves and the hash for the loaded board
+    game->moves = initialise_move_index(game->gameBoard, game->tiles);
+    game->hash = grid_hash(game->gameBoard);
     // Game loop
     while (true) {
         int command[3];
@@ -434,27 +1008,99 @@ ErrorCode game_loop(Game* game) {
         Player* prevPlayer = players[(turn + 1) % 2];
         Board* gameBoard = game->gameBoard;     
         // Displays the grid regardless of the type defined   
-        grid_display(gameBoard);
-        // check whether there are any valid move
-        if (!check_possible_move(game, currentPlayer)) {
-            printf("Player %s wins\n", prevPlayer->symbol);
+        if (!headless && game->options.drawChanges) {
+            grid_display_changes(gameBoard);
+        } else if (!headless) {
+            grid_display(gameBoard);
+        }
+        // The search of an automatic player both checks whether there are
+        // any valid move and finds the move it makes, while a human only
+        // needs to know whether a move exists
+        MoveSearch search;
+        prepare_player_search(game, currentPlayer, &search);
+        if (currentPlayer->type == HUMAN ? 
+                !check_possible_move(game, currentPlayer) :
+                !find_move(game, &search)) {
+            game->winner = prevPlayer;
+            if (!headless) {
+                printf("Player %s wins\n", prevPlayer->symbol);
+            }
             break;
         }
         // Prompt user if current player is human nd displays the tile
         if (currentPlayer->type == HUMAN) {
             display_tiles(game->tiles, true);
             if (!human_prompt(game, currentPlayer, command)) {
-                free_game(game);
                 return EOF_DETECTED;
             }
-        } else if (currentPlayer->type == P1_AUTO) {
-            algorithm_one(game, players);
-        } else if (currentPlayer->type == P2_AUTO) {
-            algorithm_two(game, currentPlayer);
+        } else {
+            // A searching player looks further than the first legal move
+            if (currentPlayer->type == P3_AUTO) {
+                search_move(game, &search);
+            } else if (currentPlayer->type == P4_AUTO) {
+                mcts_move(game, &search);
+            } else if (currentPlayer->type == P5_AUTO) {
+                parallel_search_move(game, &search);
+            }
+            play_search_move(game, &search);
         }
 
     }
     // Cannot reach here unless game loop terminated because some player won 
+    return NO_ERROR;
+}
+
+/*
+    Plays the game until it has ended and frees the game.
+
+    @param game contains the player, tile and board object enabling 
+    @returns whether the game has been ended or stopped voluntarily by the user
+*/
+ErrorCode game_loop(Game* game) {
+    ErrorCode result = play_game(game);
     free_game(game);
+    return result;
+}
+
+/*
+    Plays the given number of games between two automatic players back to
+    back without displaying anything but a summary of every game: the winner,
+    the number of moves, the time taken and the moves made per second. When
+    seeded the starting tile of every game is picked at random.
+
+    @param argn the number of arguments, either five or six
+    @param input the arguments describing the tile file, players and either
+    the dimension or the saved game every game starts from
+    @param options the options the games are played with
+    @returns the ErrorCode of any invalid argument or NO_ERROR
+*/
+ErrorCode headless_games(int argn, char** input, Options* options) {
+    uint64_t random = options->seed;
+    for (int gameNumber = 1; gameNumber <= options->games; gameNumber++) {
+        Game* game = initialise_game();
+        game->options = *options;
+        ErrorCode validGame = setup_game(argn, input, game);
+        // A human cannot play without the board being displayed
+        if (validGame == NO_ERROR && (game->player1->type == HUMAN ||
+                game->player2->type == HUMAN)) {
+            validGame = PLAYER_INVALID;
+        }
+        if (validGame != NO_ERROR) {
+            free_game(game);
+            return validGame;
+        }
+        if (options->seeded) {
+            game->tiles->current = next_random(&random) % game->tiles->total;
+        }
+
+        double started = current_time();
+        play_game(game);
+        double elapsed = current_time() - started;
+        double rate = elapsed > 0 ? game->movesMade / elapsed : 0;
+        printf("Game %d: Player %s wins after %d moves in %.3fs "
+                "(%.0f moves/s)\n", gameNumber, game->winner->symbol, 
+                game->movesMade, elapsed, rate);
+        free_game(game);
+    }
     return NO_ERROR;
 }
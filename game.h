@@ -1,5 +1,9 @@
 #ifndef GAME_H
 #define GAME_H
+#define PARALLEL_SCAN_CELLS (256 * 256)
+#define PARALLEL_SCAN_ROWS 8
+// Moves the history of a game first has room for
+#define HISTORY_MOVES 64
 
 #include "definition.h"
 #include "player.h"
@@ -7,6 +11,13 @@
 #include "tiles.h"
 #include "token.h"
 #include "parser.h"
+#include "moves.h"
+#include "util.h"
+#include "tournament.h"
+#include "perft.h"
+#include "stats.h"
+#include "search.h"
+#include "mcts.h"
 
 int start_game(int, char**);
 
@@ -18,10 +29,22 @@ void place_move(int*, Player*, Game*, Tiles*);
 
 void change_turn(Game*);
 
-bool valid_move(int*, Player*, Board*, Tiles*);
+bool undo_move(Game*);
+
+bool redo_move(Game*);
+
+bool valid_move(int*, Board*, Tiles*);
 
 void update_position_algorithm_one(int*, int, int*, int);
 
+void prepare_search(MoveSearch*, Player*, ScanOrder, bool, int, int);
+
+void prepare_player_search(Game*, Player*, MoveSearch*);
+
+bool find_move(Game*, MoveSearch*);
+
+void play_search_move(Game*, MoveSearch*);
+
 void algorithm_one(Game*, Player**); 
 
 void update_position_algorithm_two(int*, int, int*, int, bool);
@@ -30,6 +53,10 @@ void algorithm_two(Game*, Player*);
 
 bool check_possible_move(Game*, Player*);
 
+ErrorCode play_game(Game*);
+
 ErrorCode game_loop(Game* game);
 
+ErrorCode headless_games(int, char**, Options*);
+
 #endif
\ No newline at end of file
@@ -1,4 +1,246 @@
 #include "grid.h"
+#include "stats.h"
+#include "util.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+    Reads 64 bits of a bitboard row starting at the given column, columns
+    outside of the row are read as empty. Also used for any other bitset that
+    is packed into rows of words.
+
+    @param words the words making up a single row of a bitboard plane
+    @param rowWords the number of words in the row
+    @param col the column that becomes bit zero of the result
+    @returns the bits of the row from col to col + 63
+*/
+uint64_t read_row_window(const uint64_t* words, int rowWords,
+        int col) {
+    // Columns to the left of the board are empty, so shift them in as zeros
+    if (col < 0) {
+        if (col <= -WORD_BITS) {
+            return 0;
+        }
+        return read_row_window(words, rowWords, 0) << -col;
+    }
+    int word = col / WORD_BITS;
+    int shift = col % WORD_BITS;
+    if (word >= rowWords) {
+        return 0;
+    }
+    uint64_t bits = words[word] >> shift;
+    // The window straddles two words unless it is aligned
+    if (shift != 0 && word + 1 < rowWords) {
+        bits |= words[word + 1] << (WORD_BITS - shift);
+    }
+    return bits;
+}
+
+/*
+    Sets or clears the given bits of a bitboard row, where bit zero of the
+    bits corresponds to the given column. Bits left of the board are dropped.
+
+    @param words the words making up a single row of a bitboard plane
+    @param rowWords the number of words in the row
+    @param col the column of bit zero of the bits to be written
+    @param bits the cells to be changed
+    @param set whether the cells must be set or cleared
+*/
+void write_row_window(uint64_t* words, int rowWords, int col,
+        uint64_t bits, bool set) {
+    if (col < 0) {
+        if (col <= -WORD_BITS) {
+            return;
+        }
+        bits >>= -col;
+        col = 0;
+    }
+    int word = col / WORD_BITS;
+    int shift = col % WORD_BITS;
+    // Splitting the bits into the part of each word they belong to
+    uint64_t parts[2] = {bits << shift, 0};
+    if (shift != 0) {
+        parts[1] = bits >> (WORD_BITS - shift);
+    }
+    for (int part = 0; part < 2 && word + part < rowWords; part++) {
+        if (set) {
+            words[word + part] |= parts[part];
+        } else {
+            words[word + part] &= ~parts[part];
+        }
+    }
+}
+
+/*
+    Writes the buffered part of a frame with a single call.
+
+    @param frame the buffer holding the frame
+    @param used the number of bytes in the buffer, reset to zero
+    @param out where the frame is written
+    @returns whether the whole buffer was written
+*/
+static bool flush_frame(char* frame, size_t* used, FILE* out) {
+    // Only frames drawn for display count as rendered, not saved games
+    STATS_ADD(bytesRendered, out == stdout ? *used : 0);
+    bool written = fwrite(frame, 1, *used, out) == *used;
+    *used = 0;
+    return written;
+}
+
+/*
+    Every chunk that has no placement reads as this chunk, so the empty area
+    of the board takes no memory.
+*/
+static const Chunk EMPTY_CHUNK;
+
+/*
+    Finds the chunk holding the given row and chunk column for reading.
+
+    @param board the board containing the placements
+    @param row the row within the board
+    @param chunkCol the column of the chunk within the board
+    @returns the chunk or EMPTY_CHUNK if it has never had a placement
+*/
+static const Chunk* find_chunk(Board* board, int row, int chunkCol) {
+    Chunk** band = board->bands[row / CHUNK_SIZE];
+    if (band == NULL || band[chunkCol] == NULL) {
+        return &EMPTY_CHUNK;
+    }
+    return band[chunkCol];
+}
+
+/*
+    Finds the chunk holding the given row and chunk column for writing, 
+    allocating it and its band of chunks on first use.
+
+    @param board the board containing the placements
+    @param row the row within the board
+    @param chunkCol the column of the chunk within the board
+    @returns the chunk, which can be written
+*/
+static Chunk* claim_chunk(Board* board, int row, int chunkCol) {
+    int chunkRow = row / CHUNK_SIZE;
+    Chunk*** band = &board->bands[chunkRow];
+    if (*band == NULL) {
+        *band = calloc(board->chunkCols, sizeof(Chunk*));
+    }
+    if ((*band)[chunkCol] == NULL) {
+        (*band)[chunkCol] = calloc(1, sizeof(Chunk));
+        // Counting the chunks lying wholly within the board
+        if ((long long) (chunkRow + 1) * CHUNK_SIZE <= board->height && 
+                (long long) (chunkCol + 1) * CHUNK_SIZE <= board->width) {
+            board->claimedChunks++;
+        }
+    }
+    return (*band)[chunkCol];
+}
+
+/*
+    Frees every chunk of the board along with the directory of chunks.
+
+    @param board the board whose chunks are freed
+*/
+static void free_chunks(Board* board) {
+    for (int chunkRow = 0; chunkRow < board->chunkRows; chunkRow++) {
+        Chunk** band = board->bands[chunkRow];
+        if (band == NULL) {
+            continue;
+        }
+        for (int chunkCol = 0; chunkCol < board->chunkCols; chunkCol++) {
+            free(band[chunkCol]);
+        }
+        free(band);
+    }
+    free(board->bands);
+    board->bands = NULL;
+}
+
+/*
+    Draws a row of the board as the symbol of the player at each cell or a
+    dot if the cell is empty, followed by a line termination. Chunks without
+    any placement in the row are drawn 64 dots at a time.
+
+    @param gameBoard the board to be drawn
+    @param row the row to be drawn
+    @param out where the row is drawn, with room for width + 1 characters
+    @returns the number of characters drawn
+*/
+static size_t draw_row(Board* gameBoard, int row, char* out) {
+    int width = gameBoard->width;
+    int chunkRow = row % CHUNK_SIZE;
+    char symbols[2] = {
+        gameBoard->players[0]->symbol[0],
+        gameBoard->players[1]->symbol[0]
+    };
+    for (int chunkCol = 0; chunkCol < gameBoard->chunkCols; chunkCol++) {
+        const Chunk* chunk = find_chunk(gameBoard, row, chunkCol);
+        uint64_t occupied = chunk->occupied[chunkRow];
+        uint64_t owner = chunk->owner[chunkRow];
+        int first = chunkCol * CHUNK_SIZE;
+        int cols = width - first < CHUNK_SIZE ? width - first : CHUNK_SIZE;
+        if (occupied == 0) {
+            memset(out + first, '.', cols);
+            continue;
+        }
+        for (int bit = 0; bit < cols; bit++) {
+            out[first + bit] = (occupied >> bit & 1) ? 
+                    symbols[owner >> bit & 1] : '.';
+        }
+    }
+    out[width] = '\n';
+    return width + 1;
+}
+
+/*
+    Draws the given rows of the board into a buffer that is written with a
+    single call once full or once all the rows are drawn, so the whole frame
+    is written at once unless it is larger than FRAME_BUFFER_SIZE.
+
+    @param gameBoard the board to be drawn
+    @param top the first row to be drawn
+    @param bottom the last row to be drawn
+    @param numbered whether every row is preceded by its number
+    @param out where the rows are written
+    @returns whether every row was written
+*/
+static bool draw_rows(Board* gameBoard, int top, int bottom, bool numbered,
+        FILE* out) {
+    // Room for the longest row number and the row itself
+    size_t rowSize = gameBoard->width + 16;
+    size_t frameSize = rowSize * (bottom - top + 1);
+    size_t capacity = frameSize < FRAME_BUFFER_SIZE ? frameSize : 
+            FRAME_BUFFER_SIZE;
+    if (capacity < rowSize) {
+        capacity = rowSize;
+    }
+    char* frame = malloc(capacity);
+    size_t used = 0;
+    bool written = true;
+    for (int row = top; row <= bottom; row++) {
+        if (used + rowSize > capacity) {
+            written = flush_frame(frame, &used, out) && written;
+        }
+        if (numbered) {
+            used += sprintf(frame + used, "%d ", row);
+        }
+        used += draw_row(gameBoard, row, frame + used);
+    }
+    written = flush_frame(frame, &used, out) && written;
+    free(frame);
+    return written;
+}
+
+/*
+    Records that every change of the board has been drawn.
+
+    @param gameBoard the board that has been drawn
+*/
+static void mark_drawn(Board* gameBoard) {
+    gameBoard->changedTop = gameBoard->height;
+    gameBoard->changedBottom = -1;
+    gameBoard->displayed = true;
+}
 
 /* 
     Function to draw grid before the next turn by the players.
@@ -6,131 +248,555 @@
     @param gameBoard the pointer that reflects the existing placements made 
 */
 void grid_display(Board* gameBoard) {
-    Player*** grid = gameBoard->grid;
-    int width = gameBoard->width;
-    int height = gameBoard->height;
-
-    // Iterating each rows and columns to print the player symbol at that place
-    for (int rows = 0; rows < height; rows++) {
-        for (int cols = 0; cols < width; cols++) {
-            Player* currentPosition = grid[rows][cols];
-            if (currentPosition != NULL) {
-                printf("%s", currentPosition->symbol);
-            } else {
-                printf(".");
+    draw_rows(gameBoard, 0, gameBoard->height - 1, false, stdout);
+    mark_drawn(gameBoard);
+}
+
+/*
+    Draws only the rows that have changed since the board was last drawn,
+    each preceded by its row number, or the whole board if it has not been
+    drawn yet.
+
+    @param gameBoard the pointer that reflects the existing placements made
+*/
+void grid_display_changes(Board* gameBoard) {
+    if (!gameBoard->displayed) {
+        grid_display(gameBoard);
+    } else if (gameBoard->changedTop <= gameBoard->changedBottom) {
+        draw_rows(gameBoard, gameBoard->changedTop, gameBoard->changedBottom,
+                true, stdout);
+        mark_drawn(gameBoard);
+    }
+}
+
+/*
+    Writes every row of the board to a file in the same layout as it is
+    drawn, as used by a saved game.
+
+    @param gameBoard the board to be written
+    @param out the file the rows are written to
+    @returns whether every row was written
+*/
+bool grid_write(Board* gameBoard, FILE* out) {
+    return draw_rows(gameBoard, 0, gameBoard->height - 1, false, out);
+}
+
+/*
+    Spreads the 32 bits of a number to the even bits of a word, so bit n
+    becomes bit 2n.
+
+    @param bits the bits to be spread
+    @returns the word with the bits at even positions
+*/
+static uint64_t spread_bits(uint64_t bits) {
+    bits &= 0xffffffffull;
+    bits = (bits | bits << 16) & 0x0000ffff0000ffffull;
+    bits = (bits | bits << 8) & 0x00ff00ff00ff00ffull;
+    bits = (bits | bits << 4) & 0x0f0f0f0f0f0f0f0full;
+    bits = (bits | bits << 2) & 0x3333333333333333ull;
+    return (bits | bits << 1) & 0x5555555555555555ull;
+}
+
+/*
+    Gathers the even bits of a word into 32 bits, so bit 2n becomes bit n.
+
+    @param bits the word whose even bits are gathered
+    @returns the gathered bits
+*/
+static uint64_t gather_bits(uint64_t bits) {
+    bits &= 0x5555555555555555ull;
+    bits = (bits | bits >> 1) & 0x3333333333333333ull;
+    bits = (bits | bits >> 2) & 0x0f0f0f0f0f0f0f0full;
+    bits = (bits | bits >> 4) & 0x00ff00ff00ff00ffull;
+    bits = (bits | bits >> 8) & 0x0000ffff0000ffffull;
+    return (bits | bits >> 16) & 0xffffffffull;
+}
+
+/*
+    Writes every row of the board to a file with two bits for every cell,
+    zero if empty, one for the first player and two for the second player.
+    Every row starts on a new byte and takes PACKED_ROW_BYTES(width) bytes,
+    with the first cell in the lowest bits.
+
+    @param gameBoard the board to be written
+    @param out the file the rows are written to
+    @returns whether every row was written
+*/
+bool grid_write_packed(Board* gameBoard, FILE* out) {
+    size_t rowBytes = PACKED_ROW_BYTES(gameBoard->width);
+    size_t capacity = rowBytes > FRAME_BUFFER_SIZE ? rowBytes : 
+            FRAME_BUFFER_SIZE;
+    // Room for whole chunks, as the last one may be past the row
+    unsigned char* frame = malloc(capacity + CHUNK_SIZE / 4);
+    size_t used = 0;
+    bool written = true;
+    for (int row = 0; row < gameBoard->height; row++) {
+        if (used + rowBytes > capacity) {
+            written = flush_frame((char*) frame, &used, out) && written;
+        }
+        for (int chunkCol = 0; chunkCol < gameBoard->chunkCols; chunkCol++) {
+            const Chunk* chunk = find_chunk(gameBoard, row, chunkCol);
+            uint64_t occupied = chunk->occupied[row % CHUNK_SIZE];
+            uint64_t owner = chunk->owner[row % CHUNK_SIZE];
+            uint64_t firsts = occupied & ~owner;
+            uint64_t seconds = occupied & owner;
+            // Every chunk row makes 16 bytes, in two words of 32 cells
+            unsigned char* bytes = frame + used + chunkCol * CHUNK_SIZE / 4;
+            for (int half = 0; half < 2; half++) {
+                int shift = half * 32;
+                uint64_t cells = spread_bits(firsts >> shift) | 
+                        spread_bits(seconds >> shift) << 1;
+                for (int byte = 0; byte < 8; byte++) {
+                    bytes[half * 8 + byte] = cells >> (byte * 8) & 0xff;
+                }
             }
         }
-        printf("\n");
+        used += rowBytes;
     }
+    written = flush_frame((char*) frame, &used, out) && written;
+    free(frame);
+    return written;
 }
 
-/* 
+/*
+    Checks whether a row of a game saved in the binary format has only
+    acceptable cells, and if so places them on the board 64 cells at a time.
+
+    @param board the board on which the row is placed, with its dimension
+    given by the saved game
+    @param row the row of the board being loaded
+    @param bytes the PACKED_ROW_BYTES(width) bytes of the row
+    @returns whether every cell is valid and no cell is past the row
+*/
+bool grid_load_packed_row(Board* board, int row, const unsigned char* bytes) {
+    int width = board->width;
+    size_t rowBytes = PACKED_ROW_BYTES(width);
+    for (int col = 0; col < width; col += WORD_BITS) {
+        uint64_t halves[2] = {0, 0};
+        size_t first = (size_t) col / 4;
+        for (size_t byte = first; byte < first + 16 && byte < rowBytes; 
+                byte++) {
+            halves[(byte - first) / 8] |= 
+                    (uint64_t) bytes[byte] << ((byte - first) % 8 * 8);
+        }
+        uint64_t firsts = gather_bits(halves[0]) | 
+                gather_bits(halves[1]) << 32;
+        uint64_t seconds = gather_bits(halves[0] >> 1) | 
+                gather_bits(halves[1] >> 1) << 32;
+        int count = width - col < WORD_BITS ? width - col : WORD_BITS;
+        uint64_t inside = count == WORD_BITS ? ~(uint64_t) 0 : 
+                ((uint64_t) 1 << count) - 1;
+        // A cell cannot belong to both players or lie past the row
+        if ((firsts & seconds) || ((firsts | seconds) & ~inside)) {
+            return false;
+        }
+        if (firsts != 0) {
+            grid_set_row_bits(board, row, col, firsts, board->players[0]);
+        }
+        if (seconds != 0) {
+            grid_set_row_bits(board, row, col, seconds, board->players[1]);
+        }
+    }
+    return true;
+}
+
+/*
+    Records that a row has changed since the board was last drawn.
+
+    @param board the board that has changed
+    @param row the row that has changed
+*/
+static void mark_changed(Board* board, int row) {
+    if (row < board->changedTop) {
+        board->changedTop = row;
+    }
+    if (row > board->changedBottom) {
+        board->changedBottom = row;
+    }
+}
+
+/*
     Reallocates grid from 1x1 to user defined dimension, once arguments are
-    validated to be correct.
+    validated to be correct. All the cells of the new grid are empty, and no
+    chunk is allocated until a placement is made in it.
 
     @param grid contains the existing placements
     @param height contains information about board height
     @param width contains informaton about board width
 */
 void reallocate_grid(Board* grid, int height, int width) {
+    // Every chunk starts out empty
+    free_chunks(grid);
+    grid->chunkRows = (height + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    grid->chunkCols = (width + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    grid->bands = calloc(grid->chunkRows, sizeof(Chunk**));
+    grid->wholeChunks = (long long) (height / CHUNK_SIZE) * 
+            (width / CHUNK_SIZE);
+    grid->claimedChunks = 0;
 
-    // Reallocates the number of rows in the board to new value
-    grid->grid = realloc(grid->grid, sizeof(Player**) * height);
-
-    // For each row reallocating the number of columns in that row
-    for (int eachRow = 0; eachRow < height; eachRow++) {
-        // Weird? Just pleasing valgrind so that reallocation only happens
-        // if the memory is allocated in the first place
-        if (eachRow < grid->height) {
-            grid->grid[eachRow] = 
-                    realloc(grid->grid[eachRow], sizeof(Player*) * width);
-        } else {
-            grid->grid[eachRow] = malloc(sizeof(Player*) * width);
-        }
-        // Defining each column to be NULL 
-        for (int eachCol = 0; eachCol < width; eachCol++) {
-            grid->grid[eachRow][eachCol] = NULL;
-        }     
-    }
     // Changing the dimension information of the board
     grid->width = width;
     grid->height = height;
+    // A new board has to be drawn in full
+    grid->changedTop = 0;
+    grid->changedBottom = height - 1;
+    grid->displayed = false;
 }
 
-/* 
-    Checks whether grid contains only acceptable characters as the saved game
-    is read character by character. If valid, the corresponding player pointer
-    is set in the row and column of the board. 
-
-    @param row the current row being read in the saved file
-    @param col the current column being read in the saved file
-    @param value the current value in the saved file
-    @param game to modify the grid content
-    @returns whether the grid content is valid and contains correct dimension
-*/
-bool valid_grid_content(int row, int col, char value, Game* game) {
-    Board* board = game->gameBoard;
-    int maxWidth = board->width;
-    int maxHeight = board->height;
-   
-    Player*** coordinate = board->grid;
-    Player* player1 = game->player1;
-    Player* player2 = game->player2;
-    
-    // If the current row or column exceeds the dimension then indicates it as
-    // an invalid file
-    if (row >= maxHeight || col >= maxWidth) {
-        return false;
+/*
+    Gets the player that has a placement at the given cell of the board.
+
+    @param board the board containing the placements
+    @param row the row of the cell, must be within the board
+    @param col the column of the cell, must be within the board
+    @returns the player owning the cell or NULL if the cell is empty
+*/
+Player* grid_get(Board* board, int row, int col) {
+    const Chunk* chunk = find_chunk(board, row, col / CHUNK_SIZE);
+    uint64_t bit = (uint64_t) 1 << (col % CHUNK_SIZE);
+    if (!(chunk->occupied[row % CHUNK_SIZE] & bit)) {
+        return NULL;
     }
+    return board->players[(chunk->owner[row % CHUNK_SIZE] & bit) != 0];
+}
+
+/*
+    Sets a single cell of the board to the given player or empties it.
 
-    // Checks whether value is of acceptable type and assigns the value
-    // at the respective position. Returns false if contains any unacceptable
-    // characters
-    if (value == '#') {
-        coordinate[row][col] = player2;
-    } else if (value == '*') {
-        coordinate[row][col] = player1;
-    } else if (value == '.') {
-        coordinate[row][col] = NULL;
+    @param board the board containing the placements
+    @param row the row of the cell, must be within the board
+    @param col the column of the cell, must be within the board
+    @param player the player to place at the cell or NULL to empty it
+*/
+void grid_set(Board* board, int row, int col, Player* player) {
+    if (player == NULL) {
+        // An empty chunk has nothing to clear
+        if (find_chunk(board, row, col / CHUNK_SIZE) != &EMPTY_CHUNK) {
+            Chunk* chunk = claim_chunk(board, row, col / CHUNK_SIZE);
+            uint64_t bit = (uint64_t) 1 << (col % CHUNK_SIZE);
+            chunk->occupied[row % CHUNK_SIZE] &= ~bit;
+            chunk->owner[row % CHUNK_SIZE] &= ~bit;
+        }
+        mark_changed(board, row);
     } else {
+        grid_set_row_bits(board, row, col, 1, player);
+    }
+}
+
+/*
+    Gets the occupancy of 64 consecutive cells of a row, which allows a whole
+    row of a tile to be tested against the board with a single AND. The cells
+    come from at most two neighbouring chunks, and chunks that have never had
+    a placement are read without touching any memory of their own.
+
+    @param board the board containing the placements
+    @param row the row to be read, rows outside the board are empty
+    @param col the column that becomes bit zero of the result
+    @returns a mask with bit n set if the cell at col + n is occupied
+*/
+uint64_t grid_row_bits(Board* board, int row, int col) {
+    if (row < 0 || row >= board->height || col >= board->width ||
+            col <= -WORD_BITS) {
+        return 0;
+    }
+    // Columns to the left of the board are empty, so shift them in as zeros
+    if (col < 0) {
+        return grid_row_bits(board, row, 0) << -col;
+    }
+    Chunk** band = board->bands[row / CHUNK_SIZE];
+    if (band == NULL) {
+        return 0;
+    }
+    int chunkCol = col / CHUNK_SIZE;
+    int chunkRow = row % CHUNK_SIZE;
+    int shift = col % CHUNK_SIZE;
+    uint64_t bits = 0;
+    if (band[chunkCol] != NULL) {
+        bits = band[chunkCol]->occupied[chunkRow] >> shift;
+    }
+    // The window straddles two chunks unless it is aligned
+    if (shift != 0 && chunkCol + 1 < board->chunkCols && 
+            band[chunkCol + 1] != NULL) {
+        bits |= band[chunkCol + 1]->occupied[chunkRow] << (WORD_BITS - shift);
+    }
+    return bits;
+}
+
+/*
+    Places the player on every cell of a row given by the bits, where bit zero
+    of the bits corresponds to the given column. The bits must be within the
+    board, and the chunks they fall into are allocated if still empty.
+
+    @param board the board containing the placements
+    @param row the row in which the cells are placed
+    @param col the column of bit zero of the bits
+    @param bits the cells to be placed
+    @param player the player that owns the placed cells
+*/
+void grid_set_row_bits(Board* board, int row, int col, uint64_t bits,
+        Player* player) {
+    if (col < 0) {
+        bits >>= -col;
+        col = 0;
+    }
+    // Splitting the bits into the part of each chunk they belong to
+    int chunkCol = col / CHUNK_SIZE;
+    uint64_t parts[2] = {0, 0};
+    write_row_window(parts, 2, col % CHUNK_SIZE, bits, true);
+    for (int part = 0; part < 2; part++) {
+        if (parts[part] == 0) {
+            continue;
+        }
+        Chunk* chunk = claim_chunk(board, row, chunkCol + part);
+        chunk->occupied[row % CHUNK_SIZE] |= parts[part];
+        // Only the second player has their owner bits set
+        if (player->firstPlayer) {
+            chunk->owner[row % CHUNK_SIZE] &= ~parts[part];
+        } else {
+            chunk->owner[row % CHUNK_SIZE] |= parts[part];
+        }
+    }
+    mark_changed(board, row);
+}
+
+/*
+    Removes the placements from every cell of a row given by the bits, where
+    bit zero of the bits corresponds to the given column, undoing
+    grid_set_row_bits. The chunks stay allocated even when left empty.
+
+    @param board the board containing the placements
+    @param row the row in which the cells are cleared
+    @param col the column of bit zero of the bits
+    @param bits the cells to be cleared
+*/
+void grid_clear_row_bits(Board* board, int row, int col, uint64_t bits) {
+    if (col < 0) {
+        bits >>= -col;
+        col = 0;
+    }
+    int chunkCol = col / CHUNK_SIZE;
+    uint64_t parts[2] = {0, 0};
+    write_row_window(parts, 2, col % CHUNK_SIZE, bits, true);
+    Chunk** band = board->bands[row / CHUNK_SIZE];
+    for (int part = 0; part < 2; part++) {
+        if (parts[part] == 0 || band == NULL || 
+                band[chunkCol + part] == NULL) {
+            continue;
+        }
+        Chunk* chunk = band[chunkCol + part];
+        chunk->occupied[row % CHUNK_SIZE] &= ~parts[part];
+        chunk->owner[row % CHUNK_SIZE] &= ~parts[part];
+    }
+    mark_changed(board, row);
+}
+
+/*
+    Checks whether any chunk lying wholly within the board has never had a
+    placement, in which case every tile fits within that chunk.
+
+    @param board the board containing the placements
+    @returns whether the board has a whole chunk that is empty
+*/
+bool grid_has_empty_chunk(Board* board) {
+    return board->claimedChunks < board->wholeChunks;
+}
+
+/*
+    Converts up to 64 characters of a saved board row into the cells of each
+    player. With SSE2 the characters are classified 16 at a time, otherwise
+    character by character.
+
+    @param text the first character to be converted
+    @param count the number of characters, at most 64
+    @param first set to the cells of the first player, '*'
+    @param second set to the cells of the second player, '#'
+    @returns whether every character is one of '.', '*' and '#'
+*/
+static bool convert_cells(const char* text, int count, uint64_t* first,
+        uint64_t* second) {
+    int col = 0;
+    *first = 0;
+    *second = 0;
+#ifdef __SSE2__
+    __m128i empties = _mm_set1_epi8('.');
+    __m128i firsts = _mm_set1_epi8('*');
+    __m128i seconds = _mm_set1_epi8('#');
+    for (; col + 16 <= count; col += 16) {
+        __m128i block = _mm_loadu_si128((const __m128i*) (text + col));
+        uint64_t firstBits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, firsts));
+        uint64_t secondBits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, 
+                seconds));
+        uint64_t emptyBits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, 
+                empties));
+        if ((firstBits | secondBits | emptyBits) != 0xffff) {
+            return false;
+        }
+        *first |= firstBits << col;
+        *second |= secondBits << col;
+    }
+#endif
+    for (; col < count; col++) {
+        if (text[col] == '*') {
+            *first |= (uint64_t) 1 << col;
+        } else if (text[col] == '#') {
+            *second |= (uint64_t) 1 << col;
+        } else if (text[col] != '.') {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    Checks whether a row of a saved game contains only acceptable characters
+    followed by a line termination. If valid, the placements of the row are
+    written to the board 64 cells at a time.
+
+    @param board the board on which the row is placed, with its dimension
+    given by the saved game
+    @param row the row of the board being loaded
+    @param text the characters of the row in the saved file
+    @returns whether the row is valid and contains correct dimension
+*/
+bool grid_load_row(Board* board, int row, const char* text) {
+    int width = board->width;
+    if (text[width] != '\n') {
         return false;
     }
-    // If here then all invalidities does not apply, hence content is valid
+    for (int col = 0; col < width; col += WORD_BITS) {
+        int count = width - col < WORD_BITS ? width - col : WORD_BITS;
+        uint64_t cells[2];
+        if (!convert_cells(text + col, count, &cells[0], &cells[1])) {
+            return false;
+        }
+        for (int player = 0; player < 2; player++) {
+            if (cells[player] != 0) {
+                grid_set_row_bits(board, row, col, cells[player], 
+                        board->players[player]);
+            }
+        }
+    }
     return true;
 }
 
-/* 
+/*
     Initialises a grid structure in memory used at the start of every game.
-    Initially the grid is defined as 1x1 with its value pointing to NULL.
+    Initially the grid is defined as 1x1 with its only cell empty.
 
     @returns a board loaded with default values
 */
 Board* initialise_grid(void) {
     Board* newGrid = malloc(sizeof(Board));
-    newGrid->width = 1;
-    newGrid->height = 1;
-    // Initially it is a 1x1 array
-    newGrid->grid = malloc(sizeof(Player**) * 1);
-    newGrid->grid[0] = malloc(sizeof(Player*) * 1);
-    // Defining the only element to be NULL
-    newGrid->grid[0][0] = NULL;
+    newGrid->bands = NULL;
+    newGrid->chunkRows = 0;
+    newGrid->players[0] = NULL;
+    newGrid->players[1] = NULL;
+    // Initially it is a 1x1 board
+    reallocate_grid(newGrid, 1, 1);
     return newGrid;
 }
 
-/* 
+/*
+    Copies a board along with its placements, only allocating the chunks
+    allocated on the original, so the copy can be changed on its own.
+
+    @param board the board to be copied
+    @returns the copy of the board
+*/
+Board* copy_grid(Board* board) {
+    Board* copy = initialise_grid();
+    reallocate_grid(copy, board->height, board->width);
+    copy->players[0] = board->players[0];
+    copy->players[1] = board->players[1];
+    for (int chunkRow = 0; chunkRow < board->chunkRows; chunkRow++) {
+        Chunk** band = board->bands[chunkRow];
+        for (int chunkCol = 0; band != NULL && chunkCol < board->chunkCols;
+                chunkCol++) {
+            if (band[chunkCol] != NULL) {
+                *claim_chunk(copy, chunkRow * CHUNK_SIZE, chunkCol) =
+                        *band[chunkCol];
+            }
+        }
+    }
+    return copy;
+}
+
+/*
+    Gets the bytes taken by the chunks of a board, at most, counting every
+    chunk on the bottom and right edges of the board as allocated.
+
+    @param board the board whose chunks are counted
+    @returns the bytes of the chunks
+*/
+size_t grid_bytes(Board* board) {
+    return (size_t) (board->claimedChunks + board->chunkRows + 
+            board->chunkCols) * sizeof(Chunk);
+}
+
+/*
+    Gets the Zobrist key of a cell of the board. The keys are mixed from the
+    position of the cell rather than stored, as boards can be very large.
+
+    @param row the row of the cell
+    @param col the column of the cell
+    @returns the key of the cell
+*/
+uint64_t grid_cell_key(int row, int col) {
+    uint64_t state = ZOBRIST_SEED ^ ((uint64_t) (uint32_t) row << 32 |
+            (uint32_t) col);
+    return next_random(&state);
+}
+
+/*
+    Computes the Zobrist hash of the occupied cells of the board. Who owns a
+    cell does not change the moves either player can make, as both place the
+    same tiles under the same rules, so only the occupied cells are hashed.
+
+    @param board the board containing the placements
+    @returns the hash of the board
+*/
+uint64_t grid_hash(Board* board) {
+    uint64_t hash = 0;
+    for (int row = 0; row < board->height; row++) {
+        for (int col = 0; col < board->width; col += WORD_BITS) {
+            uint64_t bits = grid_row_bits(board, row, col);
+            while (bits != 0) {
+                hash ^= grid_cell_key(row, col + __builtin_ctzll(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+    return hash;
+}
+
+/*
+    Gets the keys of the cells a tile rotation covers when centered at the
+    given position, which toggles the cells in the hash of a board.
+
+    @param shape the tile rotation
+    @param centerRow the row of the center of the tile
+    @param centerCol the column of the center of the tile
+    @returns the keys of the cells XORed together
+*/
+uint64_t grid_shape_key(TileShape* shape, int centerRow, int centerCol) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    uint64_t key = 0;
+    for (int cell = 0; cell < shape->cellCount; cell++) {
+        key ^= grid_cell_key(
+                centerRow - offset + shape->cells[cell] / TILE_GRID_SQR_DIM,
+                centerCol - offset + shape->cells[cell] % TILE_GRID_SQR_DIM);
+    }
+    return key;
+}
+
+/*
     To free the memory used by the grid after an error or end of game.
-    
+
     @param grid contains the Board data structure holding information about
     game and dimension.
 */
 void free_grid(Board* grid) {
-    int rows = grid->height;
-
-    // Free each column
-    for (int y = 0; y < rows; y++) {
-        free(grid->grid[y]);
-    }
-    // Free each row and the Board data structure
-    free(grid->grid);
+    // Free every chunk and the Board data structure
+    free_chunks(grid);
     free(grid);
 }
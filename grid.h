@@ -1,17 +1,57 @@
 #ifndef GRID_H
 #define GRID_H
+#define WORD_BITS 64
+#define FRAME_BUFFER_SIZE (1024 * 1024)
+// Bytes taken by a row of the given width with two bits for every cell
+#define PACKED_ROW_BYTES(width) (((size_t) (width) + 3) / 4)
+// Seed of the Zobrist keys of the cells
+#define ZOBRIST_SEED 0x2545f4914f6cdd1dull
 
 #include "definition.h"
 
 
+uint64_t read_row_window(const uint64_t*, int, int);
+
+void write_row_window(uint64_t*, int, int, uint64_t, bool);
+
 void grid_display(Board*);
 
+void grid_display_changes(Board*);
+
+bool grid_write(Board*, FILE*);
+
+bool grid_write_packed(Board*, FILE*);
+
 void reallocate_grid(Board*, int, int);
 
-bool valid_grid_content(int, int, char, Game*);
+Player* grid_get(Board*, int, int);
+
+void grid_set(Board*, int, int, Player*);
+
+uint64_t grid_row_bits(Board*, int, int);
+
+void grid_set_row_bits(Board*, int, int, uint64_t, Player*);
+
+void grid_clear_row_bits(Board*, int, int, uint64_t);
+
+bool grid_has_empty_chunk(Board*);
+
+bool grid_load_row(Board*, int, const char*);
+
+bool grid_load_packed_row(Board*, int, const unsigned char*);
 
 Board* initialise_grid(void);
 
+Board* copy_grid(Board*);
+
+size_t grid_bytes(Board*);
+
+uint64_t grid_cell_key(int, int);
+
+uint64_t grid_hash(Board*);
+
+uint64_t grid_shape_key(TileShape*, int, int);
+
 void free_grid(Board*);
 
 #endif
\ No newline at end of file
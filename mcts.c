@@ -0,0 +1,555 @@
+#include "mcts.h"
+#include "game.h"
+#include <math.h>
+#include <pthread.h>
+
+/*
+    A move of an MCTS player shared by the threads running its playouts. The
+    tree is only read or changed while holding lock, and started counts the
+    playouts handed out so far, up to limit when a number of playouts is
+    given, otherwise until the deadline.
+*/
+typedef struct {
+    Game* game;
+    MctsTree* tree;
+    pthread_mutex_t lock;
+    int started;
+    int limit;
+    double deadline;
+    uint64_t seed;
+} MctsSearch;
+
+/*
+    A single thread running the playouts of an MCTS move.
+*/
+typedef struct {
+    MctsSearch* search;
+    uint64_t random;
+} MctsWorker;
+
+/*
+    Frees the nodes below a node of the tree.
+
+    @param node the node whose children are freed
+    @returns the number of nodes freed
+*/
+static long long free_children(MctsNode* node) {
+    long long freed = node->childCount;
+    for (int child = 0; child < node->childCount; child++) {
+        freed += free_children(&node->children[child]);
+    }
+    free(node->children);
+    node->children = NULL;
+    node->childCount = 0;
+    return freed;
+}
+
+/*
+    Frees the tree of an MCTS player.
+
+    @param tree the tree to be freed, which may be NULL
+*/
+void free_mcts_tree(MctsTree* tree) {
+    if (tree == NULL) {
+        return;
+    }
+    free_children(tree->root);
+    free(tree->root);
+    free(tree);
+}
+
+/*
+    Gets the step visiting every candidate row once, in an order starting
+    anywhere and jumping around the board, a random step with no common
+    factor with the number of rows.
+
+    @param rows the number of candidate rows
+    @param random the state of the random sequence
+    @returns the step between the rows visited
+*/
+static int row_step(int rows, uint64_t* random) {
+    int step = (int) (next_random(random) % rows);
+    while (true) {
+        int a = step;
+        int b = rows;
+        while (b != 0) {
+            int rest = a % b;
+            a = b;
+            b = rest;
+        }
+        if (a == 1) {
+            return step;
+        }
+        step = (step + 1) % rows;
+    }
+}
+
+/*
+    Lists the legal moves of the current tile on the board, the centers of
+    every distinct rotation found by legal_center_run. The candidate rows are
+    visited in a random order, and the listing stops once MCTS_LIST_SPARE
+    times room moves have been found or the deadline has passed, so a large
+    board is not swept whole. A uniformly random sample of room moves out of
+    those found is kept.
+
+    @param board the board containing the placements
+    @param tiles the tiles, whose current tile is placed
+    @param moves set to the row, column and rotation of the moves kept
+    @param room the most moves kept
+    @param random the state of the random sequence picking the sample
+    @param deadline the time the listing stops at
+    @returns the number of moves kept, or -1 if the deadline passed before
+    any move was found
+*/
+static int list_moves(Board* board, Tiles* tiles, int (*moves)[3], int room,
+        uint64_t* random, double deadline) {
+    Tile* tile = &tiles->list[tiles->current];
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int rows = board->height + 2 * offset;
+    int cols = board->width + 2 * offset;
+    int rowWords = (cols + WORD_BITS - 1) / WORD_BITS;
+    int step = row_step(rows, random);
+    int row = (int) (next_random(random) % rows);
+    long long found = 0;
+    uint64_t legal[LEGAL_RUN_WORDS];
+    for (int visited = 0; visited < rows; visited++) {
+        if (found >= (long long) MCTS_LIST_SPARE * room) {
+            break;
+        } else if (visited % MCTS_LIST_ROWS == MCTS_LIST_ROWS - 1 &&
+                current_time() >= deadline) {
+            if (found == 0) {
+                return -1;
+            }
+            break;
+        }
+        row = (row + step) % rows;
+        for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+            if (tile->sameRotation[rotation] != rotation) {
+                continue;
+            }
+            for (int word = 0; word < rowWords; word += LEGAL_RUN_WORDS) {
+                int run = rowWords - word < LEGAL_RUN_WORDS ?
+                        rowWords - word : LEGAL_RUN_WORDS;
+                legal_center_run(board, &tile->rotations[rotation],
+                        row - offset, word * WORD_BITS - offset, run, legal);
+                for (int each = 0; each < run; each++) {
+                    uint64_t bits = legal[each];
+                    while (bits != 0) {
+                        int col = (word + each) * WORD_BITS +
+                                __builtin_ctzll(bits);
+                        bits &= bits - 1;
+                        if (col >= cols) {
+                            break;
+                        }
+                        // Reservoir sampling keeps every move equally likely
+                        long long slot = found < room ? found :
+                                (long long) (next_random(random) %
+                                (found + 1));
+                        found++;
+                        if (slot < room) {
+                            moves[slot][0] = row - offset;
+                            moves[slot][1] = col - offset;
+                            moves[slot][2] = rotation * 90;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return found < room ? found : room;
+}
+
+/*
+    Finds a random legal move of the current tile of a playout, first by
+    trying random positions with valid_move and then by picking one of the
+    listed legal moves.
+
+    @param playout the game being played out
+    @param move set to the row, column and rotation of the move
+    @param random the state of the random sequence
+    @param deadline the time listing the moves stops at
+    @returns 1 if a move was found, 0 if the player to move has no legal
+    move, or -1 if the deadline passed before a move was found
+*/
+static int random_move(Game* playout, int move[3], uint64_t* random,
+        double deadline) {
+    Board* board = playout->gameBoard;
+    int offset = TILE_GRID_SQR_DIM / 2;
+    for (int attempt = 0; attempt < MCTS_PLAYOUT_TRIES; attempt++) {
+        move[0] = (int) (next_random(random) % (board->height + 2 * offset))
+                - offset;
+        move[1] = (int) (next_random(random) % (board->width + 2 * offset))
+                - offset;
+        move[2] = (int) (next_random(random) % POSSIBLE_ROTATION) * 90;
+        if (valid_move(move, board, playout->tiles)) {
+            return 1;
+        }
+    }
+    int listed[1][3];
+    int found = list_moves(board, playout->tiles, listed, 1, random, 
+            deadline);
+    if (found > 0) {
+        memcpy(move, listed[0], sizeof(listed[0]));
+    }
+    return found;
+}
+
+/*
+    Makes a move in a playout with place_move, moving on to the next turn
+    and tile.
+
+    @param playout the game being played out
+    @param move the row, column and rotation of the move
+*/
+static void playout_move(Game* playout, int move[3]) {
+    Player* player = playout->turn == 0 ? playout->player1 :
+            playout->player2;
+    place_move(move, player, playout, playout->tiles);
+    change_turn(playout);
+    change_tiles(playout);
+}
+
+/*
+    Sets up a private copy of the game for a playout, with its own board,
+    players and current tile so playouts can run side by side.
+
+    @param game the game being played
+    @param playout set to the copy of the game
+    @param players set to the copies of the players
+    @param tiles set to the copy of the tiles, sharing the tile list
+*/
+static void start_playout(Game* game, Game* playout, Player players[2],
+        Tiles* tiles) {
+    *playout = *game;
+    players[0] = *game->player1;
+    players[1] = *game->player2;
+    *tiles = *game->tiles;
+    playout->player1 = &players[0];
+    playout->player2 = &players[1];
+    playout->tiles = tiles;
+    playout->moves = NULL;
+    playout->counts = NULL;
+    playout->journal = NULL;
+    playout->history = NULL;
+    playout->gameBoard = copy_grid(game->gameBoard);
+    playout->gameBoard->players[0] = &players[0];
+    playout->gameBoard->players[1] = &players[1];
+}
+
+/*
+    Chooses the child of a node to play out with UCT, where the playouts
+    still running through a child count as lost, so threads spread over
+    different children.
+
+    @param node the node whose child is chosen
+    @returns the child to be played out
+*/
+static MctsNode* select_child(MctsNode* node) {
+    double logVisits = log((double) (node->visits + node->virtualLoss + 1));
+    MctsNode* best = NULL;
+    double bestScore = -1;
+    for (int each = 0; each < node->childCount; each++) {
+        MctsNode* child = &node->children[each];
+        double visits = (double) (child->visits + child->virtualLoss);
+        if (visits == 0) {
+            return child;
+        }
+        double score = child->wins / visits +
+                MCTS_EXPLORATION * sqrt(logVisits / visits);
+        if (score > bestScore) {
+            best = child;
+            bestScore = score;
+        }
+    }
+    return best;
+}
+
+/*
+    Expands a node of the tree with a child for each legal move of the
+    playout, unless another thread has expanded it meanwhile, the tree is
+    full or the deadline passed before any move was listed. The moves are
+    listed without holding the lock.
+
+    @param search the move being searched
+    @param node the node to be expanded
+    @param playout the game at the position of the node
+    @param random the state of the random sequence
+    @param deadline the time listing the moves stops at
+*/
+static void expand_node(MctsSearch* search, MctsNode* node, Game* playout,
+        uint64_t* random, double deadline) {
+    int (*moves)[3] = malloc(sizeof(int[3]) * MCTS_MAX_CHILDREN);
+    int total = list_moves(playout->gameBoard, playout->tiles, moves,
+            MCTS_MAX_CHILDREN, random, deadline);
+    if (total < 0) {
+        free(moves);
+        return;
+    }
+    MctsNode* children = calloc(total > 0 ? total : 1, sizeof(MctsNode));
+    for (int each = 0; each < total; each++) {
+        memcpy(children[each].move, moves[each], sizeof(moves[each]));
+    }
+    free(moves);
+
+    pthread_mutex_lock(&search->lock);
+    if (!node->expanded && search->tree->nodes + total <= MCTS_MAX_NODES) {
+        node->children = children;
+        node->childCount = total;
+        node->expanded = true;
+        search->tree->nodes += total;
+        children = NULL;
+    }
+    pthread_mutex_unlock(&search->lock);
+    free(children);
+}
+
+/*
+    Plays out the game at random until a player has no legal move or the
+    playout has made MCTS_PLAYOUT_MOVES moves. A playout cut short by the
+    deadline while listing the moves counts as a draw as well.
+
+    @param playout the game being played out
+    @param random the state of the random sequence
+    @param deadline the time listing the moves stops at
+    @returns the turn of the winner, or -1 for a draw when cut short
+*/
+static int random_playout(Game* playout, uint64_t* random, double deadline) {
+    for (int moves = 0; moves < MCTS_PLAYOUT_MOVES; moves++) {
+        int move[3];
+        int found = random_move(playout, move, random, deadline);
+        if (found == 0) {
+            return 1 - playout->turn;
+        } else if (found < 0) {
+            return -1;
+        }
+        playout_move(playout, move);
+    }
+    return -1;
+}
+
+/*
+    Runs a single playout: chooses a path down the tree, expands the node
+    reached, plays out the game from there at random and counts the result
+    in every node of the path.
+
+    @param worker the thread running the playout
+*/
+static void run_playout(MctsWorker* worker) {
+    MctsSearch* search = worker->search;
+    MctsNode* path[MCTS_MAX_PATH + 1];
+    int length = 0;
+    Game playout;
+    Player players[2];
+    Tiles tiles;
+    start_playout(search->game, &playout, players, &tiles);
+    // Only a playout limited by time stops listing moves at the deadline
+    double deadline = search->limit > 0 ? INFINITY : search->deadline;
+
+    pthread_mutex_lock(&search->lock);
+    MctsNode* node = search->tree->root;
+    path[length++] = node;
+    node->virtualLoss++;
+    while (node->expanded && node->childCount > 0 &&
+            length < MCTS_MAX_PATH) {
+        node = select_child(node);
+        path[length++] = node;
+        node->virtualLoss++;
+    }
+    bool leaf = !node->expanded && length < MCTS_MAX_PATH;
+    pthread_mutex_unlock(&search->lock);
+    for (int each = 1; each < length; each++) {
+        playout_move(&playout, path[each]->move);
+    }
+
+    // A new leaf is expanded and one of its children played out
+    if (leaf) {
+        expand_node(search, node, &playout, &worker->random, deadline);
+        MctsNode* child = NULL;
+        pthread_mutex_lock(&search->lock);
+        if (node->childCount > 0) {
+            child = &node->children[next_random(&worker->random) %
+                    node->childCount];
+            path[length++] = child;
+            child->virtualLoss++;
+        }
+        pthread_mutex_unlock(&search->lock);
+        if (child != NULL) {
+            playout_move(&playout, child->move);
+        }
+    }
+    int winner = random_playout(&playout, &worker->random, deadline);
+    free_grid(playout.gameBoard);
+
+    // The move into the node at depth d was made on the turn d - 1 moves
+    // after the root
+    pthread_mutex_lock(&search->lock);
+    for (int each = 0; each < length; each++) {
+        int mover = (search->game->turn + each + 1) % 2;
+        path[each]->virtualLoss--;
+        path[each]->visits++;
+        if (winner < 0) {
+            path[each]->wins += 0.5;
+        } else if (winner == mover) {
+            path[each]->wins += 1;
+        }
+    }
+    pthread_mutex_unlock(&search->lock);
+}
+
+/*
+    Runs playouts until the number of playouts or the time of the move has
+    been used up.
+
+    @param data the worker running the playouts
+    @returns nothing
+*/
+static void* mcts_worker(void* data) {
+    MctsWorker* worker = data;
+    MctsSearch* search = worker->search;
+    while (true) {
+        if (search->limit > 0) {
+            int started = __atomic_fetch_add(&search->started, 1,
+                    __ATOMIC_RELAXED);
+            if (started >= search->limit) {
+                break;
+            }
+        } else if (current_time() >= search->deadline) {
+            break;
+        }
+        run_playout(worker);
+    }
+    STATS_FLUSH();
+    return NULL;
+}
+
+/*
+    Checks whether a node of the tree made the last move of the game, which
+    is at the recent move of the game and has every cell of the previous tile
+    occupied, as only that placement could have covered them.
+
+    @param game the game after the move
+    @param node a child of the root of the tree
+    @returns whether the node made the move
+*/
+static bool made_last_move(Game* game, MctsNode* node) {
+    Tiles* tiles = game->tiles;
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int previous = (tiles->current + tiles->total - 1) % tiles->total;
+    TileShape* shape = &tiles->list[previous].rotations[node->move[2] / 90];
+    if (node->move[0] != game->recentMove[0] ||
+            node->move[1] != game->recentMove[1]) {
+        return false;
+    }
+    for (int cell = 0; cell < shape->cellCount; cell++) {
+        if (grid_get(game->gameBoard,
+                node->move[0] - offset + shape->cells[cell] /
+                TILE_GRID_SQR_DIM, node->move[1] - offset +
+                shape->cells[cell] % TILE_GRID_SQR_DIM) == NULL) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+    Moves the root of a tree down to one of its children, freeing the rest
+    of the tree.
+
+    @param tree the tree whose root is moved
+    @param child the child of the root becoming the root
+*/
+static void reroot_tree(MctsTree* tree, MctsNode* child) {
+    MctsNode* root = malloc(sizeof(MctsNode));
+    *root = *child;
+    child->children = NULL;
+    child->childCount = 0;
+    tree->nodes -= free_children(tree->root);
+    free(tree->root);
+    tree->root = root;
+}
+
+/*
+    Gets the tree of a player for the position of the game, reusing the
+    subtree of the move the opponent has made since the last turn of the
+    player and otherwise starting a new tree.
+
+    @param game the game being played
+    @param player the MCTS player whose turn it is
+    @returns the tree rooted at the position of the game
+*/
+static MctsTree* current_tree(Game* game, Player* player) {
+    MctsTree* tree = player->tree;
+    if (tree != NULL && game->movesMade == tree->movesMade + 1) {
+        MctsNode* root = tree->root;
+        for (int each = 0; each < root->childCount; each++) {
+            if (made_last_move(game, &root->children[each])) {
+                reroot_tree(tree, &root->children[each]);
+                return tree;
+            }
+        }
+    }
+    free_mcts_tree(tree);
+    tree = malloc(sizeof(MctsTree));
+    tree->root = calloc(1, sizeof(MctsNode));
+    tree->nodes = 1;
+    player->tree = tree;
+    return tree;
+}
+
+/*
+    Chooses the move of an MCTS player by running random playouts from the
+    position of the game, on the number of threads given in the options,
+    and picking the move played out the most. Playouts run for the time of
+    a move unless a number of playouts is given. The subtree of the move
+    made is kept for the next turn of the player.
+
+    @param game contains the board, tiles and options
+    @param search the search of the player, which has found a legal move
+*/
+void mcts_move(Game* game, MoveSearch* search) {
+    Player* player = search->player;
+    MctsSearch shared;
+    shared.game = game;
+    shared.tree = current_tree(game, player);
+    pthread_mutex_init(&shared.lock, NULL);
+    shared.started = 0;
+    shared.limit = game->options.playouts;
+    shared.deadline = current_time() + game->options.moveTime / 1000.0;
+    shared.seed = game->options.seeded ? game->options.seed :
+            (uint64_t) (current_time() * 1e6);
+
+    int threads = game->options.threads;
+    MctsWorker workers[MAX_THREADS];
+    pthread_t handles[MAX_THREADS];
+    for (int each = 0; each < threads; each++) {
+        workers[each].search = &shared;
+        workers[each].random = shared.seed ^
+                ((uint64_t) game->movesMade << 16 | each);
+    }
+    // The calling thread runs playouts along with the others
+    for (int each = 1; each < threads; each++) {
+        pthread_create(&handles[each], NULL, mcts_worker, &workers[each]);
+    }
+    mcts_worker(&workers[0]);
+    for (int each = 1; each < threads; each++) {
+        pthread_join(handles[each], NULL);
+    }
+    pthread_mutex_destroy(&shared.lock);
+
+    MctsTree* tree = shared.tree;
+    MctsNode* best = NULL;
+    for (int each = 0; each < tree->root->childCount; each++) {
+        MctsNode* child = &tree->root->children[each];
+        if (best == NULL || child->visits > best->visits) {
+            best = child;
+        }
+    }
+    if (best == NULL) {
+        free_mcts_tree(tree);
+        player->tree = NULL;
+        return;
+    }
+    memcpy(search->move, best->move, sizeof(best->move));
+    reroot_tree(tree, best);
+    tree->movesMade = game->movesMade + 1;
+}
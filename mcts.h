@@ -0,0 +1,26 @@
+#ifndef MCTS_H
+#define MCTS_H
+// Weight of the exploration term when choosing a child to play out
+#define MCTS_EXPLORATION 1.4
+// Most moves made by a random playout before it is counted as a draw
+#define MCTS_PLAYOUT_MOVES 256
+// Random positions tried by a playout before listing the legal moves
+#define MCTS_PLAYOUT_TRIES 32
+// Most children of a node, a random sample of the moves beyond that
+#define MCTS_MAX_CHILDREN 4096
+// Listing moves stops once it has found this many times the moves it keeps
+#define MCTS_LIST_SPARE 2
+// Rows of candidates listed between checks of the time
+#define MCTS_LIST_ROWS 64
+// Most nodes of a tree, after which no node is expanded
+#define MCTS_MAX_NODES (1 << 20)
+// Deepest path through a tree
+#define MCTS_MAX_PATH 256
+
+#include "definition.h"
+
+void mcts_move(Game*, MoveSearch*);
+
+void free_mcts_tree(MctsTree*);
+
+#endif
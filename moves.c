@@ -0,0 +1,891 @@
+#include "moves.h"
+#include "grid.h"
+#include "tiles.h"
+#include "stats.h"
+#include "util.h"
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#endif
+
+/*
+    Gets a mask with the bits from first to last set, clipped to the bits of
+    a word.
+
+    @param first the lowest bit to be set
+    @param last the highest bit to be set
+    @returns the mask containing the range of bits
+*/
+static uint64_t range_bits(long long first, long long last) {
+    if (first < 0) {
+        first = 0;
+    }
+    if (last > WORD_BITS - 1) {
+        last = WORD_BITS - 1;
+    }
+    if (first > last) {
+        return 0;
+    }
+    uint64_t upto = last == WORD_BITS - 1 ? ~(uint64_t) 0 :
+            ((uint64_t) 1 << (last + 1)) - 1;
+    return upto & ~(((uint64_t) 1 << first) - 1);
+}
+
+/*
+    Finds which of 64 consecutive centers in a row are legal placements of a
+    tile rotation. Every placeable cell of the tile is tested for all the
+    centers at once by reading the board row shifted by the column of the
+    cell.
+
+    @param board the board containing the placements
+    @param shape the tile rotation to be placed
+    @param centerRow the row of the centers
+    @param firstCol the column of the center given by bit zero of the result
+    @returns the mask where bit n is set if the tile can be placed centered at
+    centerRow and firstCol + n
+*/
+uint64_t legal_centers(Board* board, TileShape* shape, int centerRow,
+        int firstCol) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    // A tile without any placeable position fits anywhere
+    if (shape->cellCount == 0) {
+        return ~(uint64_t) 0;
+    }
+    long long top = (long long) centerRow - offset;
+    if (top + shape->top < 0 || top + shape->bottom >= board->height) {
+        return 0;
+    }
+    // Only the centers keeping every placeable cell within the board
+    long long first = (long long) offset - shape->left - firstCol;
+    long long last = (long long) board->width - 1 + offset - shape->right -
+            firstCol;
+    uint64_t legal = range_bits(first, last);
+
+    // Removing the centers where any placeable cell is already occupied
+    for (int cell = 0; cell < shape->cellCount && legal; cell++) {
+        int tileY = shape->cells[cell] / TILE_GRID_SQR_DIM;
+        int tileX = shape->cells[cell] % TILE_GRID_SQR_DIM;
+        legal &= ~grid_row_bits(board, (int) top + tileY,
+                firstCol - offset + tileX);
+    }
+    return legal;
+}
+
+/*
+    Removes from the legal centers of a run the centers blocked by a single
+    row of a tile, one word at a time. Each placeable column x of the row mask
+    blocks the centers whose cell x lands on an occupied cell, which is the
+    board row read x columns further along.
+
+    @param line the board row under the tile row, one word more than the run
+    with bit zero of the first word under column zero of the tile grid
+    @param rowMask the placeable columns of the tile row
+    @param from the first word of the run to be processed
+    @param words the number of words in the run
+    @param legal the legal centers of the run, updated in place
+*/
+static void clear_blocked_scalar(const uint64_t* line, unsigned rowMask,
+        int from, int words, uint64_t* legal) {
+    for (int word = from; word < words; word++) {
+        uint64_t blocked = 0;
+        for (int x = 0; x < TILE_GRID_SQR_DIM; x++) {
+            if (rowMask & (1u << x)) {
+                blocked |= x == 0 ? line[word] : (line[word] >> x) | 
+                        (line[word + 1] << (WORD_BITS - x));
+            }
+        }
+        legal[word] &= ~blocked;
+    }
+}
+
+#ifdef __SSE2__
+/*
+    Same as clear_blocked_scalar, two words at a time with SSE2. Shifting a
+    lane left by 64 gives zero, so column zero needs no special case.
+*/
+static void clear_blocked_sse2(const uint64_t* line, unsigned rowMask,
+        int words, uint64_t* legal) {
+    int word = 0;
+    for (; word + 2 <= words; word += 2) {
+        __m128i low = _mm_loadu_si128((const __m128i*) (line + word));
+        __m128i high = _mm_loadu_si128((const __m128i*) (line + word + 1));
+        __m128i blocked = _mm_setzero_si128();
+        for (int x = 0; x < TILE_GRID_SQR_DIM; x++) {
+            if (rowMask & (1u << x)) {
+                blocked = _mm_or_si128(blocked, _mm_or_si128(
+                        _mm_srl_epi64(low, _mm_cvtsi32_si128(x)),
+                        _mm_sll_epi64(high, 
+                        _mm_cvtsi32_si128(WORD_BITS - x))));
+            }
+        }
+        __m128i* out = (__m128i*) (legal + word);
+        _mm_storeu_si128(out, _mm_andnot_si128(blocked, 
+                _mm_loadu_si128(out)));
+    }
+    clear_blocked_scalar(line, rowMask, word, words, legal);
+}
+#endif
+
+#if defined(__x86_64__) && defined(__GNUC__)
+/*
+    Same as clear_blocked_scalar, four words at a time with AVX2. Only called
+    once the processor has been found to support AVX2.
+*/
+__attribute__((target("avx2")))
+static void clear_blocked_avx2(const uint64_t* line, unsigned rowMask,
+        int words, uint64_t* legal) {
+    int word = 0;
+    for (; word + 4 <= words; word += 4) {
+        __m256i low = _mm256_loadu_si256((const __m256i*) (line + word));
+        __m256i high = _mm256_loadu_si256((const __m256i*) (line + word + 
+                1));
+        __m256i blocked = _mm256_setzero_si256();
+        for (int x = 0; x < TILE_GRID_SQR_DIM; x++) {
+            if (rowMask & (1u << x)) {
+                blocked = _mm256_or_si256(blocked, _mm256_or_si256(
+                        _mm256_srl_epi64(low, _mm_cvtsi32_si128(x)),
+                        _mm256_sll_epi64(high, 
+                        _mm_cvtsi32_si128(WORD_BITS - x))));
+            }
+        }
+        __m256i* out = (__m256i*) (legal + word);
+        _mm256_storeu_si256(out, _mm256_andnot_si256(blocked, 
+                _mm256_loadu_si256(out)));
+    }
+    clear_blocked_scalar(line, rowMask, word, words, legal);
+}
+#endif
+
+/*
+    Removes from the legal centers of a run the centers blocked by a single
+    row of a tile, using the widest kernel the processor supports.
+
+    @param line the board row under the tile row, one word more than the run
+    @param rowMask the placeable columns of the tile row
+    @param words the number of words in the run
+    @param legal the legal centers of the run, updated in place
+*/
+static void clear_blocked(const uint64_t* line, unsigned rowMask, int words,
+        uint64_t* legal) {
+#if defined(__x86_64__) && defined(__GNUC__)
+    if (__builtin_cpu_supports("avx2")) {
+        clear_blocked_avx2(line, rowMask, words, legal);
+        return;
+    }
+#endif
+#ifdef __SSE2__
+    clear_blocked_sse2(line, rowMask, words, legal);
+#else
+    clear_blocked_scalar(line, rowMask, 0, words, legal);
+#endif
+}
+
+/*
+    Finds which centers of a run of consecutive words of centers in a row are
+    legal placements of a tile rotation, giving the same result as calling
+    legal_centers for every word. Each row of the board under the tile is
+    read once for the whole run and combined with the row masks of the tile.
+
+    @param board the board containing the placements
+    @param shape the tile rotation to be placed
+    @param centerRow the row of the centers
+    @param firstCol the column of the center given by bit zero of the first
+    word of the result
+    @param words the number of words in the run, at most LEGAL_RUN_WORDS
+    @param legal set to the run, where bit n of word w is set if the tile can
+    be placed centered at centerRow and firstCol + 64w + n
+*/
+void legal_center_run(Board* board, TileShape* shape, int centerRow,
+        int firstCol, int words, uint64_t* legal) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    long long top = (long long) centerRow - offset;
+    if (shape->cellCount == 0) {
+        memset(legal, 0xff, sizeof(uint64_t) * words);
+        return;
+    }
+    if (top + shape->top < 0 || top + shape->bottom >= board->height) {
+        memset(legal, 0, sizeof(uint64_t) * words);
+        return;
+    }
+    long long first = (long long) offset - shape->left - firstCol;
+    long long last = (long long) board->width - 1 + offset - shape->right -
+            firstCol;
+    STATS_ADD(legalRunWords, words);
+    for (int word = 0; word < words; word++) {
+        legal[word] = range_bits(first - (long long) word * WORD_BITS,
+                last - (long long) word * WORD_BITS);
+    }
+
+    uint64_t line[LEGAL_RUN_WORDS + 1];
+    for (int tileY = shape->top; tileY <= shape->bottom; tileY++) {
+        unsigned rowMask = (shape->mask >> (tileY * TILE_GRID_SQR_DIM)) &
+                ((1u << TILE_GRID_SQR_DIM) - 1);
+        if (rowMask == 0) {
+            continue;
+        }
+        for (int word = 0; word <= words; word++) {
+            line[word] = grid_row_bits(board, (int) top + tileY,
+                    firstCol - offset + word * WORD_BITS);
+        }
+        clear_blocked(line, rowMask, words, legal);
+    }
+}
+
+/*
+    Gets the bitset of a slot within the index.
+
+    @param index the index of legal moves
+    @param slot the slot of a distinct tile rotation
+    @returns the first word of the bitset
+*/
+static uint64_t* index_bitset(MoveIndex* index, int slot) {
+    return index->bitsets[slot];
+}
+
+/*
+    Gets the slot of a tile rotation within the index.
+
+    @param index the index of legal moves
+    @param tile the index of the tile
+    @param rotation the rotation index of the tile
+    @returns the slot shared by every tile rotation with the same shape
+*/
+static int index_slot(MoveIndex* index, int tile, int rotation) {
+    return index->slots[tile * POSSIBLE_ROTATION + rotation];
+}
+
+static void catch_up(MoveIndex*, int);
+
+/*
+    Gets the slot of a tile rotation within the index, brought up to date
+    with the board.
+
+    @param index the index of legal moves
+    @param tile the index of the tile
+    @param rotation the rotation index of the tile
+    @returns the slot of the tile rotation
+*/
+static int ready_slot(MoveIndex* index, int tile, int rotation) {
+    int slot = index_slot(index, tile, rotation);
+    catch_up(index, slot);
+    return slot;
+}
+
+/*
+    Builds the bitset of legal centers of a slot from the placements already
+    made on the board.
+
+    @param index the index of legal moves
+    @param board the board containing the placements
+    @param shape the tile rotation of the slot
+    @param slot the slot to be built
+*/
+static void build_slot(MoveIndex* index, Board* board, TileShape* shape, 
+        int slot) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int rowWords = index->rowWords;
+    uint64_t* bitset = index_bitset(index, slot);
+    long long count = 0;
+    // Candidate row and column n are the centers n - 2
+    for (int row = 0; row < index->rows; row++) {
+        uint64_t* words = bitset + (size_t) row * rowWords;
+        for (int word = 0; word < rowWords; word += LEGAL_RUN_WORDS) {
+            int run = rowWords - word < LEGAL_RUN_WORDS ? rowWords - word :
+                    LEGAL_RUN_WORDS;
+            legal_center_run(board, shape, row - offset, 
+                    word * WORD_BITS - offset, run, words + word);
+        }
+        // Clearing the centers past the last candidate column
+        words[rowWords - 1] &= range_bits(0, index->cols - 1 - 
+                (rowWords - 1) * WORD_BITS);
+        for (int word = 0; word < rowWords; word++) {
+            count += __builtin_popcountll(words[word]);
+        }
+    }
+    index->counts[slot] = count;
+}
+
+/*
+    Builds the index of the legal moves of every tile rotation on the board
+    from the placements already made. Tile rotations with the same shape, as
+    found when the tiles were loaded, share a slot. The index is not built if
+    it would use more than MAX_INDEX_BYTES of memory.
+
+    @param board the board containing the placements
+    @param tiles the tiles that can be placed on the board
+    @returns the index of legal moves or NULL if the index is too large
+*/
+MoveIndex* initialise_move_index(Board* board, Tiles* tiles) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int rows = board->height + 2 * offset;
+    int cols = board->width + 2 * offset;
+    int rowWords = (cols + WORD_BITS - 1) / WORD_BITS;
+    int rotations = tiles->total * POSSIBLE_ROTATION;
+    int* slots = malloc(sizeof(int) * rotations);
+    int* shapes = malloc(sizeof(int) * rotations);
+    int distinct = 0;
+    for (int tile = 0; tile < tiles->total; tile++) {
+        Tile* current = &tiles->list[tile];
+        for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+            int same = current->sameRotation[rotation];
+            int* slot = &slots[tile * POSSIBLE_ROTATION + rotation];
+            if (current->sameTile != tile) {
+                *slot = slots[current->sameTile * POSSIBLE_ROTATION + 
+                        rotation];
+            } else if (same != rotation) {
+                *slot = slots[tile * POSSIBLE_ROTATION + same];
+            } else {
+                shapes[distinct] = tile * POSSIBLE_ROTATION + rotation;
+                *slot = distinct++;
+            }
+        }
+    }
+    size_t words = (size_t) distinct * rows * rowWords;
+    if (words * sizeof(uint64_t) > MAX_INDEX_BYTES) {
+        free(slots);
+        free(shapes);
+        return NULL;
+    }
+
+    MoveIndex* index = malloc(sizeof(MoveIndex));
+    index->total = tiles->total;
+    index->distinct = distinct;
+    index->rows = rows;
+    index->cols = cols;
+    index->rowWords = rowWords;
+    index->slots = slots;
+    index->shapes = shapes;
+    index->legal = malloc(sizeof(uint64_t) * words);
+    index->bitsets = malloc(sizeof(uint64_t*) * distinct);
+    index->owned = NULL;
+    for (int slot = 0; slot < distinct; slot++) {
+        index->bitsets[slot] = index->legal + (size_t) slot * rows * rowWords;
+    }
+    index->counts = malloc(sizeof(long long) * distinct);
+    index->board = board;
+    index->tiles = tiles;
+    index->changes = malloc(sizeof(int) * 2 * MOVE_INDEX_CHANGES);
+    index->changed = 0;
+    index->seen = calloc(distinct, sizeof(long long));
+    for (int slot = 0; slot < distinct; slot++) {
+        int shape = shapes[slot];
+        build_slot(index, board, &tiles->list[shape / POSSIBLE_ROTATION].
+                rotations[shape % POSSIBLE_ROTATION], slot);
+    }
+    return index;
+}
+
+/*
+    Frees the index of legal moves.
+
+    @param index the index to be freed, which may be NULL
+*/
+void free_move_index(MoveIndex* index) {
+    if (index == NULL) {
+        return;
+    }
+    for (int slot = 0; index->owned != NULL && slot < index->distinct; 
+            slot++) {
+        if (index->owned[slot]) {
+            free(index->bitsets[slot]);
+        }
+    }
+    free(index->slots);
+    free(index->shapes);
+    free(index->legal);
+    free(index->bitsets);
+    free(index->owned);
+    free(index->counts);
+    free(index->changes);
+    free(index->seen);
+    free(index);
+}
+
+/*
+    Copies the index of legal moves, so the copy can follow a board copied
+    with copy_grid. The copy shares the bitsets of the index until its slots
+    catch up with changes, so the index must not change, nor be freed, while
+    the copy is in use. Looking up the copy leaves the index untouched, hence
+    several copies of an index can be used at once by different threads.
+
+    @param index the index to be copied, which may be NULL
+    @param board the copy of the board the copy of the index follows
+    @returns the copy of the index or NULL
+*/
+MoveIndex* copy_move_index(MoveIndex* index, Board* board) {
+    if (index == NULL) {
+        return NULL;
+    }
+    MoveIndex* copy = malloc(sizeof(MoveIndex));
+    *copy = *index;
+    int rotations = index->total * POSSIBLE_ROTATION;
+    copy->slots = malloc(sizeof(int) * rotations);
+    copy->shapes = malloc(sizeof(int) * rotations);
+    copy->legal = NULL;
+    copy->bitsets = malloc(sizeof(uint64_t*) * index->distinct);
+    copy->owned = calloc(index->distinct, sizeof(bool));
+    copy->counts = malloc(sizeof(long long) * index->distinct);
+    memcpy(copy->slots, index->slots, sizeof(int) * rotations);
+    memcpy(copy->shapes, index->shapes, sizeof(int) * index->distinct);
+    memcpy(copy->bitsets, index->bitsets, 
+            sizeof(uint64_t*) * index->distinct);
+    memcpy(copy->counts, index->counts, sizeof(long long) * index->distinct);
+    copy->board = board;
+    copy->changes = malloc(sizeof(int) * 2 * MOVE_INDEX_CHANGES);
+    copy->seen = malloc(sizeof(long long) * index->distinct);
+    memcpy(copy->changes, index->changes, 
+            sizeof(int) * 2 * MOVE_INDEX_CHANGES);
+    memcpy(copy->seen, index->seen, sizeof(long long) * index->distinct);
+    return copy;
+}
+
+/*
+    Brings a slot up to date after the cells of a tile centered at the given
+    position have changed. Only the centers within four cells of the tile
+    center can overlap the changed cells, hence only that 9x9 neighbourhood
+    of the slot is tested again.
+
+    @param index the index of legal moves
+    @param slot the slot to be brought up to date
+    @param centerRow the row of the center of the changed tile
+    @param centerCol the column of the center of the changed tile
+*/
+static void update_slot(MoveIndex* index, int slot, int centerRow, 
+        int centerCol) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int reach = 2 * offset;
+    // The neighbourhood in candidate coordinates, clipped to the index
+    long long firstRow = (long long) centerRow + offset - reach;
+    long long lastRow = (long long) centerRow + offset + reach;
+    long long firstCol = (long long) centerCol + offset - reach;
+    long long lastCol = (long long) centerCol + offset + reach;
+    if (firstRow < 0) {
+        firstRow = 0;
+    }
+    if (lastRow > index->rows - 1) {
+        lastRow = index->rows - 1;
+    }
+    if (firstCol < 0) {
+        firstCol = 0;
+    }
+    if (lastCol > index->cols - 1) {
+        lastCol = index->cols - 1;
+    }
+    if (firstRow > lastRow || firstCol > lastCol) {
+        return;
+    }
+    uint64_t window = range_bits(0, lastCol - firstCol);
+    // The words of a row the neighbourhood lies across
+    int windowWords = lastCol / WORD_BITS - firstCol / WORD_BITS + 1;
+
+    int tile = index->shapes[slot] / POSSIBLE_ROTATION;
+    int rotation = index->shapes[slot] % POSSIBLE_ROTATION;
+    TileShape* shape = &index->tiles->list[tile].rotations[rotation];
+    uint64_t* bitset = index_bitset(index, slot);
+    long long* count = &index->counts[slot];
+    STATS_ADD(indexRowsTested, lastRow - firstRow + 1);
+    for (int row = firstRow; row <= lastRow; row++) {
+        uint64_t* words = bitset + (size_t) row * index->rowWords;
+        uint64_t before = read_row_window(words, index->rowWords,
+                firstCol) & window;
+        uint64_t after = legal_centers(index->board, shape, row - offset,
+                firstCol - offset) & window;
+        if (before == after) {
+            continue;
+        }
+        // Replacing the neighbourhood of the row with the new result
+        STATS_ADD(indexWordsUpdated, windowWords);
+        write_row_window(words, index->rowWords, firstCol, window, false);
+        write_row_window(words, index->rowWords, firstCol, after, true);
+        *count += __builtin_popcountll(after) - __builtin_popcountll(before);
+    }
+}
+
+/*
+    Brings a slot up to date with every change of the board it has not yet
+    seen. The neighbourhood of every change is tested again from the board
+    as it is now, which gives the same result whatever order the changes
+    were made in. The whole slot is built again instead when its changes
+    have left the ring or testing them would take longer than testing every
+    row once.
+
+    @param index the index of legal moves
+    @param slot the slot to be brought up to date
+*/
+static void catch_up(MoveIndex* index, int slot) {
+    long long pending = index->changed - index->seen[slot];
+    if (pending == 0) {
+        return;
+    } else if (index->owned != NULL && !index->owned[slot]) {
+        // A copy takes its own bitset of the slot before changing it
+        size_t bytes = sizeof(uint64_t) * index->rows * index->rowWords;
+        uint64_t* bitset = malloc(bytes);
+        memcpy(bitset, index->bitsets[slot], bytes);
+        index->bitsets[slot] = bitset;
+        index->owned[slot] = true;
+    }
+    int neighbourhood = 4 * (TILE_GRID_SQR_DIM / 2) + 1;
+    if (pending > MOVE_INDEX_CHANGES || pending * neighbourhood >= 
+            (long long) index->rows * index->rowWords) {
+        int shape = index->shapes[slot];
+        build_slot(index, index->board, &index->tiles->
+                list[shape / POSSIBLE_ROTATION].
+                rotations[shape % POSSIBLE_ROTATION], slot);
+    } else {
+        for (long long each = index->seen[slot]; each < index->changed; 
+                each++) {
+            int* change = &index->changes[2 * (each % MOVE_INDEX_CHANGES)];
+            update_slot(index, slot, change[0], change[1]);
+        }
+    }
+    index->seen[slot] = index->changed;
+}
+
+/*
+    Records that the cells of a tile centered at the given position have
+    changed on the board the index follows. The slots catch up with the
+    change once they are looked up, so a change costs the same however many
+    tiles there are.
+
+    @param index the index of legal moves
+    @param centerRow the row of the center of the changed tile
+    @param centerCol the column of the center of the changed tile
+*/
+void update_move_index(MoveIndex* index, int centerRow, int centerCol) {
+    int* change = &index->changes[2 * (index->changed % MOVE_INDEX_CHANGES)];
+    change[0] = centerRow;
+    change[1] = centerCol;
+    index->changed++;
+}
+
+/*
+    Brings every slot of the index up to date, after which looking up the
+    index changes nothing so threads can share it.
+
+    @param index the index of legal moves
+*/
+void move_index_sync(MoveIndex* index) {
+    for (int slot = 0; slot < index->distinct; slot++) {
+        catch_up(index, slot);
+    }
+}
+
+/*
+    Checks whether the tile can be placed anywhere on the board in any of its
+    rotations.
+
+    @param index the index of legal moves
+    @param tile the index of the tile
+    @returns whether any legal move exists for the tile
+*/
+bool move_index_any(MoveIndex* index, int tile) {
+    for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+        if (index->counts[ready_slot(index, tile, rotation)] > 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/*
+    Gets the number of legal centers of a tile rotation on the board.
+
+    @param index the index of legal moves
+    @param tile the index of the tile
+    @param rotation the rotation index of the tile
+    @returns the number of legal moves of the tile rotation
+*/
+long long move_index_count(MoveIndex* index, int tile, int rotation) {
+    return index->counts[ready_slot(index, tile, rotation)];
+}
+
+/*
+    Finds the first legal center of a tile rotation in scan order starting
+    from and including the given candidate, wrapping around the board. The
+    candidates are numbered row by row, where candidate row and column n are
+    the centers n - 2. Empty words are skipped 64 candidates at a time.
+
+    @param index the index of legal moves
+    @param tile the index of the tile
+    @param rotation the rotation index of the tile
+    @param start the number of the candidate where the scan starts
+    @param forward whether the scan goes left to right and top to bottom or
+    right to left and bottom to top
+    @returns the number of the first legal candidate or -1 if there is none
+*/
+long long move_index_next(MoveIndex* index, int tile, int rotation,
+        long long start, bool forward) {
+    int slot = ready_slot(index, tile, rotation);
+    STATS_ADD(indexLookups, 1);
+    if (index->counts[slot] == 0) {
+        return -1;
+    }
+    uint64_t* bitset = index_bitset(index, slot);
+    int rows = index->rows;
+    int rowWords = index->rowWords;
+    int startRow = start / index->cols;
+    int startCol = start % index->cols;
+
+    // The start row is visited again at the end for the part before start
+    for (int step = 0; step <= rows; step++) {
+        int row = forward ? (startRow + step) % rows :
+                (startRow - step + rows) % rows;
+        uint64_t* words = bitset + (size_t) row * rowWords;
+        for (int each = 0; each < rowWords; each++) {
+            int word = forward ? each : rowWords - 1 - each;
+            uint64_t legal = words[word];
+            STATS_ADD(indexWordsScanned, 1);
+            if (step == 0) {
+                // Only the candidates at or after the start in scan order
+                int first = forward ? startCol - word * WORD_BITS : 0;
+                int last = forward ? WORD_BITS - 1 :
+                        startCol - word * WORD_BITS;
+                legal &= range_bits(first, last);
+            }
+            if (legal == 0) {
+                continue;
+            }
+            int bit = forward ? __builtin_ctzll(legal) :
+                    WORD_BITS - 1 - __builtin_clzll(legal);
+            return (long long) row * index->cols + word * WORD_BITS + bit;
+        }
+    }
+    return -1;
+}
+
+/*
+    Gets the candidate rows and columns at which a tile rotation lies wholly
+    on the board, where candidate row and column n are the centers n - 2.
+    Every other candidate puts a placeable cell off the board.
+
+    @param board the board on which the tile is placed
+    @param shape the tile rotation
+    @param bounds set to the first and last candidate row followed by the
+    first and last candidate column, empty when the tile never fits
+*/
+static void fitting_bounds(Board* board, TileShape* shape, int bounds[4]) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    bounds[0] = 0;
+    bounds[1] = board->height - 1 + 2 * offset;
+    bounds[2] = 0;
+    bounds[3] = board->width - 1 + 2 * offset;
+    // A tile without any placeable position fits at every candidate
+    if (shape->cellCount == 0) {
+        return;
+    }
+    bounds[0] = 2 * offset - shape->top;
+    bounds[1] -= shape->bottom;
+    bounds[2] = 2 * offset - shape->left;
+    bounds[3] -= shape->right;
+}
+
+/*
+    Gets the legal centers of a run of candidates within a candidate row,
+    each run being at most LEGAL_RUN_WORDS words.
+
+    @param board the board containing the placements
+    @param shape the tile rotation to be placed
+    @param row the candidate row
+    @param first the first candidate column of the run
+    @param last the last candidate column of the run
+    @param legal set to the run, where bit n of word w is the candidate
+    first + 64w + n
+    @returns the number of words in the run
+*/
+static int candidate_run(Board* board, TileShape* shape, int row, int first,
+        int last, uint64_t legal[LEGAL_RUN_WORDS]) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int words = (last - first) / WORD_BITS + 1;
+    legal_center_run(board, shape, row - offset, first - offset, words,
+            legal);
+    // Clearing the candidates past the end of the run
+    legal[words - 1] &= ~(uint64_t) 0 >> 
+            (words * WORD_BITS - (last - first + 1));
+    return words;
+}
+
+/*
+    Counts the legal centers of a tile rotation in a candidate row by
+    scanning the board.
+
+    @param board the board containing the placements
+    @param shape the tile rotation to be placed
+    @param row the candidate row
+    @returns the number of legal centers in the row
+*/
+long long legal_row_count(Board* board, TileShape* shape, int row) {
+    int runCols = LEGAL_RUN_WORDS * WORD_BITS;
+    int bounds[4];
+    fitting_bounds(board, shape, bounds);
+    if (row < bounds[0] || row > bounds[1]) {
+        return 0;
+    }
+    long long count = 0;
+    for (int col = bounds[2]; col <= bounds[3]; col += runCols) {
+        int last = col + runCols - 1 < bounds[3] ? col + runCols - 1 :
+                bounds[3];
+        uint64_t legal[LEGAL_RUN_WORDS];
+        int words = candidate_run(board, shape, row, col, last, legal);
+        for (int word = 0; word < words; word++) {
+            count += __builtin_popcountll(legal[word]);
+        }
+    }
+    return count;
+}
+
+/*
+    Finds the first legal center of a tile rotation in a candidate row at or
+    after the given candidate column by scanning the board.
+
+    @param board the board containing the placements
+    @param shape the tile rotation to be placed
+    @param row the candidate row
+    @param from the candidate column where the scan starts
+    @returns the candidate column of the first legal center or -1 if there
+    is none
+*/
+long long legal_row_next(Board* board, TileShape* shape, int row, int from) {
+    int runCols = LEGAL_RUN_WORDS * WORD_BITS;
+    int bounds[4];
+    fitting_bounds(board, shape, bounds);
+    if (row < bounds[0] || row > bounds[1]) {
+        return -1;
+    }
+    for (int col = from < bounds[2] ? bounds[2] : from; col <= bounds[3]; 
+            col += runCols) {
+        int last = col + runCols - 1 < bounds[3] ? col + runCols - 1 :
+                bounds[3];
+        uint64_t legal[LEGAL_RUN_WORDS];
+        int words = candidate_run(board, shape, row, col, last, legal);
+        for (int word = 0; word < words; word++) {
+            if (legal[word] != 0) {
+                return (long long) col + word * WORD_BITS +
+                        __builtin_ctzll(legal[word]);
+            }
+        }
+    }
+    return -1;
+}
+
+/*
+    Starts the counts of legal moves of every tile rotation, with nothing
+    counted yet.
+
+    @param tiles the tiles that can be placed on the board
+    @returns the counts of legal moves
+*/
+MoveCounts* initialise_move_counts(Tiles* tiles) {
+    MoveCounts* counts = malloc(sizeof(MoveCounts));
+    counts->total = tiles->total * POSSIBLE_ROTATION;
+    counts->counts = calloc(counts->total, sizeof(long long));
+    counts->ready = 0;
+    counts->rows = 0;
+    return counts;
+}
+
+/*
+    Copies the counts of legal moves, so the copy can follow a board copied
+    with copy_grid.
+
+    @param counts the counts to be copied, which may be NULL
+    @returns the copy of the counts or NULL
+*/
+MoveCounts* copy_move_counts(MoveCounts* counts) {
+    if (counts == NULL) {
+        return NULL;
+    }
+    MoveCounts* copy = malloc(sizeof(MoveCounts));
+    *copy = *counts;
+    copy->counts = malloc(sizeof(long long) * counts->total);
+    memcpy(copy->counts, counts->counts, sizeof(long long) * counts->total);
+    return copy;
+}
+
+/*
+    Frees the counts of legal moves.
+
+    @param counts the counts to be freed, which may be NULL
+*/
+void free_move_counts(MoveCounts* counts) {
+    if (counts == NULL) {
+        return;
+    }
+    free(counts->counts);
+    free(counts);
+}
+
+/*
+    Counts the legal moves of the tile rotations not yet counted, carrying
+    on from where the last call stopped, until every distinct rotation is
+    counted or the deadline has passed.
+
+    @param counts the counts of legal moves
+    @param board the board containing the placements
+    @param tiles the tiles that can be placed on the board
+    @param deadline the time at which counting stops
+    @returns whether every tile rotation has been counted
+*/
+bool build_move_counts(MoveCounts* counts, Board* board, Tiles* tiles,
+        double deadline) {
+    int rows = board->height + 2 * (TILE_GRID_SQR_DIM / 2);
+    for (; counts->ready < counts->total; counts->ready++) {
+        Tile* tile = &tiles->list[counts->ready / POSSIBLE_ROTATION];
+        int rotation = counts->ready % POSSIBLE_ROTATION;
+        if (tile->sameRotation[rotation] != rotation) {
+            continue;
+        }
+        for (; counts->rows < rows; counts->rows++) {
+            if (counts->rows % MOVE_COUNT_ROWS == 0 && 
+                    current_time() >= deadline) {
+                return false;
+            }
+            counts->counts[counts->ready] += legal_row_count(board, 
+                    &tile->rotations[rotation], counts->rows);
+        }
+        counts->rows = 0;
+    }
+    return true;
+}
+
+/*
+    Adds the legal centers of every counted tile rotation around a tile
+    centered at the given position to the counts, or takes them away. Only
+    the centers within four cells of the tile center can overlap its cells,
+    so taking them away before the cells change and adding them back after
+    keeps the counts right.
+
+    @param counts the counts of legal moves
+    @param board the board containing the placements
+    @param tiles the tiles that can be placed on the board
+    @param centerRow the row of the center of the changing tile
+    @param centerCol the column of the center of the changing tile
+    @param sign one to add the centers or minus one to take them away
+*/
+void update_move_counts(MoveCounts* counts, Board* board, Tiles* tiles,
+        int centerRow, int centerCol, int sign) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int reach = 2 * offset;
+    uint64_t window = range_bits(0, 2 * reach);
+    for (int each = 0; each <= counts->ready && each < counts->total; 
+            each++) {
+        Tile* tile = &tiles->list[each / POSSIBLE_ROTATION];
+        int rotation = each % POSSIBLE_ROTATION;
+        if (tile->sameRotation[rotation] != rotation) {
+            continue;
+        }
+        // Only the rows already counted of the rotation being counted
+        int lastRow = centerRow + reach;
+        if (each == counts->ready && lastRow + offset >= counts->rows) {
+            lastRow = counts->rows - 1 - offset;
+        }
+        long long count = 0;
+        for (int row = centerRow - reach; row <= lastRow; row++) {
+            count += __builtin_popcountll(legal_centers(board, 
+                    &tile->rotations[rotation], row, centerCol - reach) &
+                    window);
+        }
+        counts->counts[each] += sign * count;
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef MOVES_H
+#define MOVES_H
+#define MAX_INDEX_BYTES (64 * 1024 * 1024)
+#define LEGAL_RUN_WORDS 16
+// Changes of the board kept for the slots of an index to catch up with
+#define MOVE_INDEX_CHANGES 1024
+// Candidate rows counted between checks of the time
+#define MOVE_COUNT_ROWS 64
+
+#include "definition.h"
+
+MoveIndex* initialise_move_index(Board*, Tiles*);
+
+void free_move_index(MoveIndex*);
+
+MoveIndex* copy_move_index(MoveIndex*, Board*);
+
+uint64_t legal_centers(Board*, TileShape*, int, int);
+
+void legal_center_run(Board*, TileShape*, int, int, int, uint64_t*);
+
+void update_move_index(MoveIndex*, int, int);
+
+void move_index_sync(MoveIndex*);
+
+bool move_index_any(MoveIndex*, int);
+
+long long move_index_count(MoveIndex*, int, int);
+
+long long move_index_next(MoveIndex*, int, int, long long, bool);
+
+long long legal_row_count(Board*, TileShape*, int);
+
+long long legal_row_next(Board*, TileShape*, int, int);
+
+MoveCounts* initialise_move_counts(Tiles*);
+
+MoveCounts* copy_move_counts(MoveCounts*);
+
+void free_move_counts(MoveCounts*);
+
+bool build_move_counts(MoveCounts*, Board*, Tiles*, double);
+
+void update_move_counts(MoveCounts*, Board*, Tiles*, int, int, int);
+
+#endif
@@ -1,5 +1,8 @@
 #include "parser.h"
 #include "game.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
 
 /* 
     Function that takes the error code and displays matching error. 
@@ -29,6 +32,34 @@ void display_errors(ErrorCode exitCode) {
     }
 }
 
+/*
+    Validates the values of the header of a saved game and assigns them to
+    the defined Game object.
+
+    @param headerInfo the tile index, turn, height and width of the game
+    @param game the object to assign the values into
+    @returns whether the values are valid
+*/
+static bool apply_header(int* headerInfo, Game* game) {
+    Tiles* tile = game->tiles;
+    int tileIndex = headerInfo[0];
+    int gameTurn = headerInfo[1];
+    int gameHeight = headerInfo[2];
+    int gameWidth = headerInfo[3];
+    // Conditions for header to be invalid
+    if (tileIndex < 0 || tileIndex >= tile->total || gameTurn < 0
+            || gameTurn > 1 || gameHeight > MAX_DIMENSION || gameHeight < 1
+            || gameWidth > MAX_DIMENSION || gameWidth < 1) {
+        return false;
+    }
+    
+    tile->current = tileIndex;
+    game->turn = gameTurn;
+    // Reallocates the grid from 1x1 to gameHeightxgameWidth
+    reallocate_grid(game->gameBoard, gameHeight, gameWidth);  
+    return true;
+}
+
 /* 
     Validates whether the header of the loading file is valid and assigns the
     values to the defined Game object.
@@ -40,12 +71,10 @@ void display_errors(ErrorCode exitCode) {
 bool parse_header(char* firstLine, Game* game) {
     int tokenLength = 4;
     char** tokens = create_tokens(tokenLength, 10);
-    Tiles* tile = game->tiles;
     // Convert the input into tokens
     tokenise_string(tokens, firstLine, tokenLength);
 
     int headerInfo[tokenLength];
-    int totalTiles = tile->total;
 
     // For each token 
     for (int x = 0; x < tokenLength; x++) {
@@ -57,103 +86,230 @@ bool parse_header(char* firstLine, Game* game) {
     // Convert the token to a numeric value to contain information such as
     // who's turn, dimension of the grid, and the current tile index
     convert_token_to_int(tokens, headerInfo, tokenLength);
-    
-    int tileIndex = headerInfo[0];
-    int gameTurn = headerInfo[1];
-    int gameHeight = headerInfo[2];
-    int gameWidth = headerInfo[3];
-    // Conditions for header to be invalid
-    if (tileIndex < 0 || tileIndex >= totalTiles || gameTurn < 0
-            || gameTurn > 1 || gameHeight > 999 || gameHeight < 1
-            || gameWidth > 999 || gameWidth < 1) {
-        free_tokens(tokens, tokenLength);
-        return false;
-    }
-    
-    tile->current = tileIndex;
-    game->turn = gameTurn;
-    // Reallocates the grid from 1x1 to gameHeightxgameWidth
-    reallocate_grid(game->gameBoard, gameHeight, gameWidth);  
     free_tokens(tokens, tokenLength); 
-    return true;
+    return apply_header(headerInfo, game);
+}
+
+/*
+    Stores a number in four bytes, least significant byte first.
+
+    @param out where the bytes are stored
+    @param value the number to be stored
+*/
+static void put_word(unsigned char* out, uint32_t value) {
+    for (int byte = 0; byte < 4; byte++) {
+        out[byte] = value >> (byte * 8) & 0xff;
+    }
+}
+
+/*
+    Reads a number stored in four bytes, least significant byte first.
+
+    @param in the bytes holding the number
+    @returns the number
+*/
+static uint32_t get_word(const unsigned char* in) {
+    uint32_t value = 0;
+    for (int byte = 0; byte < 4; byte++) {
+        value |= (uint32_t) in[byte] << (byte * 8);
+    }
+    return value;
+}
+
+/*
+    Writes the game to a file in the binary format: the header followed by
+    every row of the board packed two bits to a cell.
+
+    @param game the state which must be saved into a file
+    @param gameWrite the file the game is written to
+    @returns whether the whole game was written
+*/
+static bool write_binary_game(Game* game, FILE* gameWrite) {
+    Board* board = game->gameBoard;
+    unsigned char header[SAVE_HEADER_BYTES];
+    memcpy(header, SAVE_MAGIC, SAVE_MAGIC_BYTES);
+    header[4] = SAVE_VERSION;
+    header[5] = game->turn;
+    put_word(header + 6, game->tiles->current);
+    put_word(header + 10, board->height);
+    put_word(header + 14, board->width);
+    bool written = fwrite(header, 1, SAVE_HEADER_BYTES, gameWrite) == 
+            SAVE_HEADER_BYTES;
+    return grid_write_packed(board, gameWrite) && written;
+}
+
+/*
+    Writes the header and every row of the game to a file, made durable on
+    disk when required.
+
+    @param game the state which must be saved into a file
+    @param gameWrite the file the game is written to
+    @param durable whether the file must be synchronised to disk
+    @returns whether the whole game was written
+*/
+static bool write_saved_game(Game* game, FILE* gameWrite, bool durable) {
+    Board* board = game->gameBoard;
+    bool written;
+    // Writing the header information first
+    if (game->options.binarySaves) {
+        written = write_binary_game(game, gameWrite);
+    } else {
+        written = fprintf(gameWrite, "%d %d %d %d\n", game->tiles->current,
+                game->turn, board->height, board->width) > 0;
+        // The rows are written a large block at a time
+        written = grid_write(board, gameWrite) && written;
+    }
+    written = fflush(gameWrite) == 0 && written;
+    if (durable) {
+        written = fsync(fileno(gameWrite)) == 0 && written;
+    }
+    return written;
 }
 
 /* 
     Takes the game object and converts it into string and saves it to the file
-    name described.
+    name described. The game is written to a temporary file next to it which
+    then replaces the file, so an interrupted save never leaves a partial
+    file behind.
 
     @param game the state which must be saved into a file
     @param token contains information about save path
 */
 void save_game(Game* game, char** token) {
-    FILE* gameWrite = fopen(token[1], "w");
-    
-    if (gameWrite == NULL) { 
-        fprintf(stderr, "Unable to save game\n");
+    char* path = token[1];
+    struct stat status;
+    // Anything but a regular file, such as a terminal, is written in place
+    if (stat(path, &status) == 0 && !S_ISREG(status.st_mode)) {
+        FILE* gameWrite = fopen(path, "w");
+        if (gameWrite == NULL) {
+            fprintf(stderr, "Unable to save game\n");
+            return;
+        }
+        write_saved_game(game, gameWrite, false);
+        fclose(gameWrite);
         return;
     }
 
-    int currentTile = game->tiles->current;
-    int currentTurn = game->turn;
+    char* tempPath = malloc(strlen(path) + sizeof(SAVE_TEMP_SUFFIX));
+    sprintf(tempPath, "%s%s", path, SAVE_TEMP_SUFFIX);
+    int descriptor = mkstemp(tempPath);
+    if (descriptor < 0) { 
+        fprintf(stderr, "Unable to save game\n");
+        free(tempPath);
+        return;
+    }
+    // The saved file gets the permissions it would get when created directly
+    mode_t mask = umask(0);
+    umask(mask);
+    fchmod(descriptor, 0666 & ~mask);
 
-    Board* board = game->gameBoard;
-    int boardWidth = board->width;
-    int boardHeight = board->height;
-    // Writing the header information first
-    fprintf(gameWrite, "%d %d %d %d\n", currentTile, currentTurn, boardHeight,
-            boardWidth);
-    fflush(gameWrite);
-    // For each row and each column of the grid writing the corresponding
-    // content
-    for (int rows = 0; rows < boardHeight; rows++) {
-        for (int cols = 0; cols < boardWidth; cols++) {
-            Player* currentPlace = board->grid[rows][cols];
-            // Write the proper string depending on the player type
-            if (currentPlace == NULL) {
-                fprintf(gameWrite, ".");
-            } else {
-                fprintf(gameWrite, "%s", currentPlace->symbol);
-            }
-        }
-        // Line termination for each row
-        fprintf(gameWrite, "\n");
+    FILE* gameWrite = fdopen(descriptor, "w");
+    bool saved = write_saved_game(game, gameWrite, true);
+    saved = fclose(gameWrite) == 0 && saved;
+    if (!saved || rename(tempPath, path) != 0) {
+        unlink(tempPath);
+        fprintf(stderr, "Unable to save game\n");
     }
-    fclose(gameWrite);
+    free(tempPath);
 }
 
-/* 
-    Checks whether the game content has the right rows, cols and returns
-    corresponding error code.
+/*
+    Loads the board of a game saved in the binary format. After the magic
+    number and version, the header holds the turn in a byte followed by the
+    tile index, height and width in four bytes each. Every row of the board
+    then takes PACKED_ROW_BYTES(width) bytes with two bits for every cell.
 
-    @param row the row reached after validating the board from saved game
-    @param maxHeight the maximum height of the board
-    @returns if the row is not same as maximum height, after exiting the loop, 
-    it indicates the file is invalid, or else no error
+    @param content the content of the saved file
+    @param size the number of characters in the content
+    @param game the object to load the information into
+    @returns indicates whether the content is valid and has correct dimension
 */
-ErrorCode check_final_dim(int row, int maxHeight) {
-    if (row != maxHeight) {
+static ErrorCode parse_binary_board(const unsigned char* content, 
+        size_t size, Game* game) {
+    if (size < SAVE_HEADER_BYTES || content[4] != SAVE_VERSION) {
         return FILE_INVALID;
     }
-    return NO_ERROR; 
+    uint32_t values[4] = {
+        get_word(content + 6),
+        content[5],
+        get_word(content + 10),
+        get_word(content + 14)
+    };
+    int headerInfo[4];
+    for (int value = 0; value < 4; value++) {
+        if (values[value] > INT_MAX) {
+            return FILE_INVALID;
+        }
+        headerInfo[value] = values[value];
+    }
+    if (!apply_header(headerInfo, game)) {
+        return FILE_INVALID;
+    }
+
+    Board* grid = game->gameBoard;
+    size_t rowLength = PACKED_ROW_BYTES(grid->width);
+    const unsigned char* rows = content + SAVE_HEADER_BYTES;
+    if (size - SAVE_HEADER_BYTES != rowLength * grid->height) {
+        return FILE_INVALID;
+    }
+    for (int row = 0; row < grid->height; row++) {
+        if (!grid_load_packed_row(grid, row, rows + row * rowLength)) {
+            return FILE_INVALID;
+        }
+    }
+    return NO_ERROR;
 }
 
 /*
-    Function to check whether the column is the maximum possible value; not
-    short or long.
+    Loads the board of a saved game held in memory. The first line is the
+    header, followed by a line for every row of the board with a character
+    for every column, unless the content starts with the magic number of the
+    binary format.
 
-    @param col the column after each line termination
-    @param maxCol the width of the board used as zero indexed for validation
-    @returns whether the column before the line termination is valid
+    @param content the content of the saved file
+    @param size the number of characters in the content
+    @param game the object to load the information into
+    @returns indicates whether the content is valid and has correct dimension
 */
-bool check_col(int col, int maxCol) {
-    if (col <= maxCol - 1) {
-        return false;
+static ErrorCode parse_saved_board(const char* content, size_t size, 
+        Game* game) {
+    if (size >= SAVE_MAGIC_BYTES && 
+            memcmp(content, SAVE_MAGIC, SAVE_MAGIC_BYTES) == 0) {
+        return parse_binary_board((const unsigned char*) content, size, game);
     }
-    return true;
+    const char* headerEnd = memchr(content, '\n', size);
+    if (headerEnd == NULL) {
+        return FILE_INVALID;
+    }
+    size_t headerLength = headerEnd - content;
+    char* firstLine = malloc(sizeof(char) * (headerLength + 1));
+    memcpy(firstLine, content, headerLength);
+    firstLine[headerLength] = '\0';
+    bool validHeader = parse_header(firstLine, game);
+    free(firstLine);
+    if (!validHeader) {
+        return FILE_INVALID;
+    }
+
+    // Every row has exactly width characters and a line termination, so
+    // the size of the rest of the file is known from the header
+    Board* grid = game->gameBoard;
+    size_t rowLength = (size_t) grid->width + 1;
+    const char* rows = headerEnd + 1;
+    if (size - headerLength - 1 != rowLength * grid->height) {
+        return FILE_INVALID;
+    }
+    for (int row = 0; row < grid->height; row++) {
+        if (!grid_load_row(grid, row, rows + row * rowLength)) {
+            return FILE_INVALID;
+        }
+    }
+    return NO_ERROR;
 }
 
 /*
-    Loads the game from the file given and convert it into game objects
+    Loads the game from the file given and convert it into game objects. The
+    whole file is read at once, or mapped into memory if it is large.
 
     @param fileName the path of the file name containing game state information
     @param game the object to load the information into
@@ -161,55 +317,242 @@ bool check_col(int col, int maxCol) {
     dimension
 */
 ErrorCode load_saved_game(char* fileName, Game* game) {
-    FILE* savedFile = fopen(fileName, "r");    
-    if (savedFile == NULL) {
+    int descriptor = open(fileName, O_RDONLY);
+    if (descriptor < 0) {
         return FILE_INACCESS;
     }
-    // creating pointers to board width and height to assign their values
-    Board* grid = game->gameBoard;
-    int* maxWidth = &(grid->width);
-    int* maxHeight = &(grid->height);
-    // Setting current character to be an invalid value initially
-    int currentCharacter = '\0';
-    bool isFirstLine = true;
-    char* firstLine = malloc(sizeof(char) * 5);
-    int row = 0;
-    int col = 0;
-    // If the current character is end of file terminate
-    while ((currentCharacter = fgetc(savedFile)) != EOF) {
-        if (currentCharacter == '\n') {
-            if (isFirstLine) {
-                // Setting last character of first line to be null terminated
-                firstLine[col] = '\0';
-                if (!parse_header(firstLine, game)) {
-                    free(firstLine);
-                    return FILE_INVALID;
-                }
-                row = 0;
-                isFirstLine = false;
-            } else if (!check_col(col, *maxWidth)) {
-                return FILE_INVALID;
-            } else {
-                row++;
+    size_t size;
+    bool mapped;
+    char* content = read_file(descriptor, &size, &mapped);
+    close(descriptor);
+    STATS_ADD(saveBytesRead, content == NULL ? 0 : size);
+    ErrorCode loaded = content == NULL ? FILE_INVALID : 
+            parse_saved_board(content, size, game);
+    release_file(content, size, mapped);
+    return loaded;
+}
+
+/*
+    Replays the moves of a journal on the game, each placing a tile and
+    passing the turn to the other player or taking back the last move. The
+    board is only checked for whether each move is legal, as the moves are
+    not read back from a board.
+
+    @param records the moves of the journal
+    @param count the number of moves
+    @param game the game the moves are made on
+    @returns whether every move is a legal move of the tile and player
+*/
+static bool replay_journal(const unsigned char* records, size_t count,
+        Game* game) {
+    Player* players[2] = {game->player1, game->player2};
+    Tiles* tiles = game->tiles;
+    for (size_t each = 0; each < count; each++) {
+        const unsigned char* record = records + each * JOURNAL_RECORD_BYTES;
+        if (record[12] == JOURNAL_UNDO) {
+            if (!undo_move(game)) {
+                return false;
             }
-            col = 0;
             continue;
         }
-        // If first line then reallocate first line to be always have
-        // space enough for give more characters for assurance
-        if (isFirstLine) {
-            firstLine = realloc(firstLine, sizeof(char) * (col + 5));
-            firstLine[col] = currentCharacter;
-        } else if (!valid_grid_content(row, col, currentCharacter, game)) { 
-            free(firstLine);
-            return FILE_INVALID;
+        uint32_t tile = get_word(record);
+        int command[3] = {
+            (int32_t) get_word(record + 4),
+            (int32_t) get_word(record + 8),
+            record[12] * 90
+        };
+        int turn = record[13];
+        if (tile >= (uint32_t) tiles->total || record[12] >= 
+                POSSIBLE_ROTATION || turn > 1) {
+            return false;
+        }
+        tiles->current = tile;
+        game->turn = turn;
+        if (!valid_move(command, game->gameBoard, tiles)) {
+            return false;
+        }
+        place_move(command, players[turn], game, tiles);
+        change_turn(game);
+        change_tiles(game);
+    }
+    return true;
+}
+
+/*
+    Resumes a game from its journal held in memory. After the magic number,
+    version and number of tiles comes the game it started from in the binary
+    format, followed by a record for every move made since. A record cut
+    short by the game stopping while writing it is left out.
+
+    @param content the content of the journal
+    @param size the number of bytes in the content
+    @param game the object to load the game into
+    @param kept set to the number of bytes of whole records and before
+    @returns indicates whether the journal is valid for the tiles of the game
+*/
+static ErrorCode parse_journal(const unsigned char* content, size_t size,
+        Game* game, size_t* kept) {
+    size_t start = JOURNAL_HEADER_BYTES + SAVE_HEADER_BYTES;
+    if (size < start || memcmp(content, JOURNAL_MAGIC, SAVE_MAGIC_BYTES) != 0
+            || content[4] != JOURNAL_VERSION || 
+            get_word(content + 5) != (uint32_t) game->tiles->total) {
+        return FILE_INVALID;
+    }
+    // The size of the starting game follows from its dimension
+    uint32_t height = get_word(content + JOURNAL_HEADER_BYTES + 10);
+    uint32_t width = get_word(content + JOURNAL_HEADER_BYTES + 14);
+    if (height > MAX_DIMENSION || width > MAX_DIMENSION) {
+        return FILE_INVALID;
+    }
+    start += PACKED_ROW_BYTES(width) * height;
+    if (size < start) {
+        return FILE_INVALID;
+    }
+    ErrorCode loaded = parse_binary_board(content + JOURNAL_HEADER_BYTES,
+            start - JOURNAL_HEADER_BYTES, game);
+    if (loaded != NO_ERROR) {
+        return loaded;
+    }
+    size_t count = (size - start) / JOURNAL_RECORD_BYTES;
+    *kept = start + count * JOURNAL_RECORD_BYTES;
+    return replay_journal(content + start, count, game) ? NO_ERROR : 
+            FILE_INVALID;
+}
+
+/*
+    Writes the start of a new journal: the magic number, version and number
+    of tiles followed by the game as it stands, made durable on disk.
+
+    @param game the game the journal starts from
+    @param journal the file of the journal
+    @returns whether the start of the journal was written
+*/
+static bool start_journal(Game* game, FILE* journal) {
+    unsigned char header[JOURNAL_HEADER_BYTES];
+    memcpy(header, JOURNAL_MAGIC, SAVE_MAGIC_BYTES);
+    header[4] = JOURNAL_VERSION;
+    put_word(header + 5, game->tiles->total);
+    bool written = fwrite(header, 1, JOURNAL_HEADER_BYTES, journal) == 
+            JOURNAL_HEADER_BYTES;
+    written = write_binary_game(game, journal) && written;
+    written = fflush(journal) == 0 && written;
+    return fsync(fileno(journal)) == 0 && written;
+}
+
+/*
+    Opens the journal the moves of the game are appended to. A journal that
+    already holds a game is resumed by replaying its moves in place of the
+    game set up from the arguments, while otherwise a new journal is started
+    from the game as set up. Saving a game rewrites the whole board, whereas
+    each move only adds a record to the journal.
+
+    @param fileName the path of the journal
+    @param game the game that has been set up from the arguments
+    @returns indicates whether the journal is accessible and valid
+*/
+ErrorCode open_journal(char* fileName, Game* game) {
+    int descriptor = open(fileName, O_RDWR | O_APPEND | O_CREAT, 0666);
+    if (descriptor < 0) {
+        return FILE_INACCESS;
+    }
+    size_t size;
+    bool mapped;
+    char* content = read_file(descriptor, &size, &mapped);
+    if (content == NULL) {
+        close(descriptor);
+        return FILE_INVALID;
+    }
+    STATS_ADD(saveBytesRead, size);
+    ErrorCode opened = NO_ERROR;
+    if (size > 0) {
+        size_t kept;
+        opened = parse_journal((const unsigned char*) content, size, game,
+                &kept);
+        // New records must follow the last whole record
+        if (opened == NO_ERROR && kept < size && 
+                ftruncate(descriptor, kept) != 0) {
+            opened = FILE_INACCESS;
         }
-        col++;
     }
-    free(firstLine); 
-    fclose(savedFile);
-    ErrorCode checkDimension = check_final_dim(row, *maxHeight);
-    return checkDimension;
+    release_file(content, size, mapped);
+    FILE* file = opened == NO_ERROR ? fdopen(descriptor, "ab") : NULL;
+    if (file == NULL) {
+        close(descriptor);
+        return opened == NO_ERROR ? FILE_INACCESS : opened;
+    }
+    if (size == 0 && !start_journal(game, file)) {
+        fclose(file);
+        return FILE_INACCESS;
+    }
+    game->journal = malloc(sizeof(Journal));
+    game->journal->file = file;
+    game->journal->unsynced = 0;
+    return NO_ERROR;
+}
+
+/*
+    Appends a record to a journal, so it reaches the file even if the game
+    stops before the next move. The journal is synchronised to disk every
+    JOURNAL_SYNC_MOVES records.
+
+    @param journal the journal of the game
+    @param record the record to be appended
+*/
+static void append_record(Journal* journal, unsigned char* record) {
+    bool written = fwrite(record, 1, JOURNAL_RECORD_BYTES, journal->file) ==
+            JOURNAL_RECORD_BYTES;
+    written = fflush(journal->file) == 0 && written;
+    if (++journal->unsynced >= JOURNAL_SYNC_MOVES) {
+        written = fsync(fileno(journal->file)) == 0 && written;
+        journal->unsynced = 0;
+    }
+    if (!written) {
+        fprintf(stderr, "Unable to write journal\n");
+    }
+}
+
+/*
+    Appends a move to the journal of the game as it is placed.
+
+    @param game the game with the journal, before the tile is changed
+    @param command the row, column and rotation of the move
+    @param playing the player making the move
+*/
+void journal_move(Game* game, int* command, Player* playing) {
+    unsigned char record[JOURNAL_RECORD_BYTES];
+    put_word(record, game->tiles->current);
+    put_word(record + 4, (uint32_t) command[0]);
+    put_word(record + 8, (uint32_t) command[1]);
+    record[12] = command[2] / 90;
+    record[13] = playing == game->player2;
+    append_record(game->journal, record);
+}
+
+/*
+    Appends to the journal of the game that its last move was taken back.
+
+    @param game the game with the journal
+*/
+void journal_undo(Game* game) {
+    unsigned char record[JOURNAL_RECORD_BYTES] = {0};
+    record[12] = JOURNAL_UNDO;
+    append_record(game->journal, record);
+}
+
+/*
+    Synchronises the journal to disk and closes it.
+
+    @param journal the journal to be closed, or NULL when there is none
+*/
+void close_journal(Journal* journal) {
+    if (journal == NULL) {
+        return;
+    }
+    if (journal->unsynced > 0) {
+        fsync(fileno(journal->file));
+    }
+    fclose(journal->file);
+    free(journal);
 }
 
 /*
@@ -230,9 +573,31 @@ bool correct_rotation(int* command) {
     return false;
 }
 
+/*
+    Takes back or makes again moves of the game until it is the turn of a
+    human, so a move of an automatic player goes along with that of the
+    human before it.
+
+    @param game the game whose moves are taken back or made again
+    @param undo whether moves are taken back rather than made again
+    @returns whether any move was taken back or made again
+*/
+static bool step_history(Game* game, bool undo) {
+    Player* players[2] = {game->player1, game->player2};
+    bool stepped = false;
+    while (undo ? undo_move(game) : redo_move(game)) {
+        stepped = true;
+        if (players[game->turn]->type == HUMAN) {
+            break;
+        }
+    }
+    return stepped;
+}
+
 /*
     Gets the input from the user, parses it and validates them, and if all good
-    it then creates the move 
+    it then creates the move, or takes back or makes again the last move when
+    asked to undo or redo
 
     @param game the game object in which the move is made on to
     @param currentPlayer the player who makes the move to change the board
@@ -259,9 +624,14 @@ bool human_prompt(Game* game, Player* currentPlayer, int* command) {
         TokenCode errorCode = validate_tokens(tokens, command);
         if (errorCode == SAVE_FILE) {
             save_game(game, tokens);
+        } else if ((errorCode == UNDO_MOVE || errorCode == REDO_MOVE) &&
+                step_history(game, errorCode == UNDO_MOVE)) {
+            free_tokens(tokens, tokenLength);
+            break;
         } else if (errorCode == NO_TOKEN_ERROR && correct_rotation(command)
-                && valid_move(command, currentPlayer, grid, currentTile)) {
+                && valid_move(command, grid, currentTile)) {
             place_move(command, currentPlayer, game, currentTile);
+            STATS_ADD(moves[HUMAN], 1);
             change_turn(game);
             change_tiles(game);
             free_tokens(tokens, tokenLength);
@@ -316,8 +686,8 @@ ErrorCode validate_dimension(char* height, char* width, Game* game) {
     int actualHeight = dimension[0];
 
     // Checking whether they are within bounds
-    if (actualHeight < 1 || actualHeight > 999 || actualWidth < 1 || 
-            actualWidth > 999) {
+    if (actualHeight < 1 || actualHeight > MAX_DIMENSION || 
+            actualWidth < 1 || actualWidth > MAX_DIMENSION) {
         return DIM_INVALID;
     }
     // Here once validations are good, and reallocates the board
@@ -325,6 +695,147 @@ ErrorCode validate_dimension(char* height, char* width, Game* game) {
     return NO_ERROR;
 }
 
+/*
+    Sets the options to their defaults, used when no option is given.
+
+    @param options the options to be initialised
+*/
+void initialise_options(Options* options) {
+    options->headless = false;
+    options->games = 1;
+    options->seeded = false;
+    options->seed = 0;
+    options->tournament = 0;
+    options->drawChanges = false;
+    options->binarySaves = false;
+    options->threads = 1;
+    options->moveTime = SEARCH_MOVE_TIME;
+    options->playouts = 0;
+    options->journal = NULL;
+    options->perft = 0;
+    options->naiveMoves = false;
+    options->stats = NULL;
+}
+
+/*
+    Converts the value of an option into a number within the given bounds.
+
+    @param value the value given after the option
+    @param min the smallest acceptable number
+    @param max the largest acceptable number
+    @param number the converted value
+    @returns whether the value is a number within the bounds
+*/
+static bool option_number(char* value, long long min, long long max, 
+        long long* number) {
+    char* nonNumeric;
+    long long converted = strtoll(value, &nonNumeric, 10);
+    if (strlen(value) == 0 || *nonNumeric || converted < min || 
+            converted > max) {
+        return false;
+    }
+    *number = converted;
+    return true;
+}
+
+/*
+    Removes the options, arguments starting with --, along with their values
+    from the arguments, so only the usual arguments remain.
+
+    @param argn the number of arguments, reduced by the removed options
+    @param input the arguments, compacted to the remaining arguments
+    @param options the options that are set by the given arguments
+    @returns whether every option is known and has a valid value
+*/
+ErrorCode parse_options(int* argn, char** input, Options* options) {
+    int kept = 0;
+    for (int index = 0; index < *argn; index++) {
+        char* argument = input[index];
+        if (index == 0 || strncmp(argument, "--", 2) != 0) {
+            input[kept++] = argument;
+            continue;
+        }
+        // Every option is followed by its value
+        if (index + 1 >= *argn) {
+            return WRONG_PARAM;
+        }
+        char* value = input[++index];
+        long long number;
+        if (strcmp(argument, "--headless") == 0 && 
+                option_number(value, 1, INT_MAX, &number)) {
+            options->headless = true;
+            options->games = (int) number;
+        } else if (strcmp(argument, "--games") == 0 && 
+                option_number(value, 1, INT_MAX, &number)) {
+            options->games = (int) number;
+        } else if (strcmp(argument, "--tournament") == 0 && 
+                option_number(value, 1, MAX_THREADS, &number)) {
+            options->tournament = (int) number;
+        } else if (strcmp(argument, "--threads") == 0 && 
+                option_number(value, 1, MAX_THREADS, &number)) {
+            options->threads = (int) number;
+        } else if (strcmp(argument, "--movetime") == 0 && 
+                option_number(value, 1, INT_MAX, &number)) {
+            options->moveTime = (int) number;
+        } else if (strcmp(argument, "--playouts") == 0 && 
+                option_number(value, 1, INT_MAX, &number)) {
+            options->playouts = (int) number;
+        } else if (strcmp(argument, "--render") == 0 && 
+                (strcmp(value, "full") == 0 || strcmp(value, "diff") == 0)) {
+            options->drawChanges = strcmp(value, "diff") == 0;
+        } else if (strcmp(argument, "--save") == 0 && 
+                (strcmp(value, "text") == 0 || strcmp(value, "binary") == 0)) {
+            options->binarySaves = strcmp(value, "binary") == 0;
+        } else if (strcmp(argument, "--perft") == 0 && 
+                option_number(value, 1, PERFT_MAX_DEPTH, &number)) {
+            options->perft = (int) number;
+        } else if (strcmp(argument, "--movegen") == 0 && 
+                (strcmp(value, "index") == 0 || strcmp(value, "naive") == 0)) {
+            options->naiveMoves = strcmp(value, "naive") == 0;
+        } else if (strcmp(argument, "--stats") == 0) {
+            options->stats = value;
+        } else if (strcmp(argument, "--journal") == 0) {
+            options->journal = value;
+        } else if (strcmp(argument, "--seed") == 0 &&
+                option_number(value, 0, LLONG_MAX, &number)) {
+            options->seeded = true;
+            options->seed = (uint64_t) number;
+        } else {
+            return WRONG_PARAM;
+        }
+    }
+    *argn = kept;
+    return NO_ERROR;
+}
+
+/*
+    Sets up a game from the arguments by validating the players and the tile
+    file, then either loading the saved game or creating an empty board of
+    the given dimension.
+
+    @param argn the number of arguments, either five or six
+    @param input the arguments given by the user
+    @param game the game to be set up
+    @returns the ErrorCode of the first argument found to be invalid
+*/
+ErrorCode setup_game(int argn, char** input, Game* game) {
+    // Set the player in the game object
+    ErrorCode validPlayer = validate_player_type(input[2], input[3], game);
+    ErrorCode validTile = validate_tile_file(input[1], game->tiles);
+    if (validTile != NO_ERROR) {
+        return validTile;
+    }
+    if (validPlayer == PLAYER_INVALID) {
+        return PLAYER_INVALID;
+    }
+    if (argn == 5) {
+        // Read saved file
+        return load_saved_game(input[4], game);
+    }
+    // Validate dimension
+    return validate_dimension(input[5], input[4], game);
+}
+
 /*
     Parses the user given argument and validates them and takes decision
     based on the number of arguments given as specified in the display_error
@@ -335,44 +846,49 @@ ErrorCode validate_dimension(char* height, char* width, Game* game) {
     exit codes
 */
 ErrorCode parse_arguments(int argn, char** input) {    
-    Game* game = initialise_game();
-    Tiles* tiles = game->tiles;
+    Options options;
+    initialise_options(&options);
+    if (parse_options(&argn, input, &options) != NO_ERROR) {
+        return WRONG_PARAM;
+    }
+    if (options.stats != NULL) {
+        start_stats(options.stats);
+    }
 
-    if (argn == 2) {
+    // A perft counts moves from a board without any players
+    if (options.perft > 0) {
+        return run_perft(argn, input, &options);
+    }
+    if (argn == 2 && !options.headless) {
         // Show only tiles and their rotated versions
-        return show_only_tiles(input[1], tiles);
-    } else if (argn == 5 || argn == 6) {
-        // Set the player in the game object
-        ErrorCode validPlayer = validate_player_type(input[2], input[3], game);
-        ErrorCode validTile = validate_tile_file(input[1], tiles);
-        if (validTile != NO_ERROR) {
-            free_game(game);
-            return validTile;
-        }
-        if (validPlayer == PLAYER_INVALID) {
-            free_game(game);
-            return PLAYER_INVALID;
-        }
-    } else {
+        Game* game = initialise_game();
+        return show_only_tiles(input[1], game->tiles);
+    } else if (argn != 5 && argn != 6) {
         return WRONG_PARAM;
     }
 
-    if (argn == 5) {
-        // Read saved file
-        ErrorCode validFile = load_saved_game(input[4], game);
-        if (validFile != NO_ERROR) {
-            free_game(game);
-            return validFile;
-        }
-    } else if(argn == 6) {
-        // Validate dimension
-        ErrorCode validDimension = 
-                validate_dimension(input[5], input[4], game);
-        if (validDimension != NO_ERROR) {
-            free_game(game);
-            return validDimension;
-        }
-        
+    // Only a single displayed game is journaled
+    if (options.journal != NULL && 
+            (options.tournament > 0 || options.headless)) {
+        return WRONG_PARAM;
+    }
+    // Games of a tournament are played in parallel
+    if (options.tournament > 0) {
+        return run_tournament(argn, input, &options);
+    }
+    // Games without display are played back to back
+    if (options.headless) {
+        return headless_games(argn, input, &options);
+    }
+    Game* game = initialise_game();
+    game->options = options;
+    ErrorCode validGame = setup_game(argn, input, game);
+    if (validGame == NO_ERROR && options.journal != NULL) {
+        validGame = open_journal(options.journal, game);
+    }
+    if (validGame != NO_ERROR) {
+        free_game(game);
+        return validGame;
     }
     // If all clear we start the game
     return game_loop(game); 
@@ -1,5 +1,24 @@
 #ifndef PARSER_H
 #define PARSER_H
+// Ending of the temporary file a game is saved to before replacing the save
+#define SAVE_TEMP_SUFFIX ".XXXXXX"
+// The start of a game saved in the binary format
+#define SAVE_MAGIC "FITZ"
+#define SAVE_MAGIC_BYTES 4
+#define SAVE_VERSION 1
+// Magic number, version, turn, then tile index, height and width
+#define SAVE_HEADER_BYTES 18
+// The start of a move journal
+#define JOURNAL_MAGIC "FITJ"
+#define JOURNAL_VERSION 1
+// Magic number, version and number of tiles, then the saved starting game
+#define JOURNAL_HEADER_BYTES 9
+// Tile index, row and column in four bytes each, then rotation and player
+#define JOURNAL_RECORD_BYTES 14
+// Rotation of the record of a move taken back
+#define JOURNAL_UNDO 0xff
+// Moves appended to a journal between synchronisations to disk
+#define JOURNAL_SYNC_MOVES 16
 
 #include "definition.h"
 
@@ -9,11 +28,15 @@ bool parse_header(char*, Game*);
 
 void save_game(Game*, char**);
 
-ErrorCode check_final_dim(int, int);
+ErrorCode load_saved_game(char*, Game*);
 
-bool check_col(int, int);
+ErrorCode open_journal(char*, Game*);
 
-ErrorCode load_saved_game(char*, Game*);
+void journal_move(Game*, int*, Player*);
+
+void journal_undo(Game*);
+
+void close_journal(Journal*);
 
 bool correct_rotation(int*);
 
@@ -25,6 +48,12 @@ ErrorCode validate_dimension(char*, char*, Game*);
 
 ErrorCode validate_tile_file(char*, Tiles*);
 
+void initialise_options(Options*);
+
+ErrorCode parse_options(int*, char**, Options*);
+
+ErrorCode setup_game(int, char**, Game*);
+
 ErrorCode parse_arguments(int, char**);
 
 #endif
@@ -0,0 +1,332 @@
+#include "perft.h"
+#include "game.h"
+#include <pthread.h>
+
+/*
+    A legal move from the position a perft starts from, along with the
+    number of move sequences of the perft depth starting with it.
+*/
+typedef struct {
+    int move[3];
+    long long nodes;
+} PerftRoot;
+
+/*
+    Everything the worker threads share. Apart from nextRoot, which hands
+    out the root moves, it is only read by the workers and every worker
+    writes the count of a root move to that move.
+*/
+typedef struct {
+    Game* game;
+    int depth;
+    int totalRoots;
+    PerftRoot* roots;
+    int nextRoot;
+} Perft;
+
+/*
+    The position a worker counts moves from, with its own copy of the board
+    and of the tiles, whose current tile is the tile to be placed next. The
+    index of legal moves is NULL when every move is checked with valid_move
+    instead.
+*/
+typedef struct {
+    Perft* perft;
+    Board* board;
+    MoveIndex* index;
+    Tiles tiles;
+    int turn;
+} PerftWorker;
+
+/*
+    Places or removes the cells of a move of the current tile of a worker,
+    keeping its index of legal moves up to date when it has one.
+
+    @param worker the worker making the move
+    @param move the row, column and rotation of the move
+    @param place whether the cells are placed or removed
+*/
+static void toggle_move(PerftWorker* worker, int move[3], bool place) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    TileShape* shape =
+            &worker->tiles.list[worker->tiles.current].rotations[move[2] / 90];
+    for (int tileY = shape->top; tileY <= shape->bottom; tileY++) {
+        uint64_t rowMask =
+                shape->mask >> (tileY * TILE_GRID_SQR_DIM) & TILE_ROW_BITS;
+        if (rowMask == 0) {
+            continue;
+        } else if (place) {
+            grid_set_row_bits(worker->board, move[0] - offset + tileY,
+                    move[1] - offset, rowMask,
+                    worker->board->players[worker->turn]);
+        } else {
+            grid_clear_row_bits(worker->board, move[0] - offset + tileY,
+                    move[1] - offset, rowMask);
+        }
+    }
+    if (worker->index != NULL) {
+        update_move_index(worker->index, move[0], move[1]);
+    }
+}
+
+/*
+    Makes a move of the current tile, moving on to the next tile in the
+    order of change_tiles and to the other player.
+
+    @param worker the worker making the move
+    @param move the row, column and rotation of the move
+*/
+static void make_move(PerftWorker* worker, int move[3]) {
+    toggle_move(worker, move, true);
+    worker->tiles.current = (worker->tiles.current + 1) % worker->tiles.total;
+    worker->turn = (worker->turn + 1) % 2;
+}
+
+/*
+    Takes back a move made with make_move.
+
+    @param worker the worker taking back the move
+    @param move the row, column and rotation of the move
+*/
+static void unmake_move(PerftWorker* worker, int move[3]) {
+    worker->turn = (worker->turn + 1) % 2;
+    worker->tiles.current = (worker->tiles.current + worker->tiles.total - 1)
+            % worker->tiles.total;
+    toggle_move(worker, move, false);
+}
+
+/*
+    Counts the move sequences of the given depth by trying every center and
+    rotation on the board with valid_move, the reference the counts of the
+    index are checked against.
+
+    @param worker the position the moves are counted from
+    @param depth the number of moves in every sequence, at least one
+    @returns the number of move sequences
+*/
+static long long naive_perft(PerftWorker* worker, int depth) {
+    Board* board = worker->board;
+    long long nodes = 0;
+    for (int row = -2; row <= board->height + 1; row++) {
+        for (int col = -2; col <= board->width + 1; col++) {
+            for (int rotation = 0; rotation < POSSIBLE_ROTATION;
+                    rotation++) {
+                int move[3] = {row, col, rotation * 90};
+                if (!valid_move(move, board, &worker->tiles)) {
+                    continue;
+                } else if (depth == 1) {
+                    nodes++;
+                    continue;
+                }
+                make_move(worker, move);
+                nodes += naive_perft(worker, depth - 1);
+                unmake_move(worker, move);
+            }
+        }
+    }
+    return nodes;
+}
+
+/*
+    Counts the move sequences of the given depth from the index of legal
+    moves. The last move of a sequence is counted from the number of legal
+    centers of each rotation without visiting them, and rotations with the
+    same shape as a lower rotation lead to the same positions, so they are
+    counted once.
+
+    @param worker the position the moves are counted from
+    @param depth the number of moves in every sequence, at least one
+    @returns the number of move sequences
+*/
+static long long indexed_perft(PerftWorker* worker, int depth) {
+    MoveIndex* index = worker->index;
+    int tile = worker->tiles.current;
+    unsigned char* sameRotation = worker->tiles.list[tile].sameRotation;
+    long long counted[POSSIBLE_ROTATION];
+    long long nodes = 0;
+    // Candidate row and column n of the index are the centers n - offset
+    int offset = TILE_GRID_SQR_DIM / 2;
+    for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+        if (sameRotation[rotation] != rotation) {
+            nodes += counted[sameRotation[rotation]];
+            continue;
+        }
+        long long count = move_index_count(index, tile, rotation);
+        counted[rotation] = depth == 1 ? count : 0;
+        long long candidate = -1;
+        for (long long each = 0; each < count && depth > 1; each++) {
+            candidate = move_index_next(index, tile, rotation, candidate + 1,
+                    true);
+            int move[3] = {
+                candidate / index->cols - offset,
+                candidate % index->cols - offset,
+                rotation * 90
+            };
+            make_move(worker, move);
+            counted[rotation] += indexed_perft(worker, depth - 1);
+            unmake_move(worker, move);
+        }
+        nodes += counted[rotation];
+    }
+    return nodes;
+}
+
+/*
+    Counts the move sequences of root moves until every root move has been
+    handed out, each on the copy of the board of the worker.
+
+    @param data the worker counting the moves
+    @returns nothing
+*/
+static void* perft_worker(void* data) {
+    PerftWorker* worker = data;
+    Perft* perft = worker->perft;
+    while (true) {
+        int rootIndex = __atomic_fetch_add(&perft->nextRoot, 1,
+                __ATOMIC_RELAXED);
+        if (rootIndex >= perft->totalRoots) {
+            break;
+        }
+        PerftRoot* root = &perft->roots[rootIndex];
+        if (perft->depth == 1) {
+            root->nodes = 1;
+            continue;
+        }
+        make_move(worker, root->move);
+        root->nodes = worker->index == NULL ?
+                naive_perft(worker, perft->depth - 1) :
+                indexed_perft(worker, perft->depth - 1);
+        unmake_move(worker, root->move);
+    }
+    STATS_FLUSH();
+    return NULL;
+}
+
+/*
+    Lists every legal move of the current tile in the position the perft
+    starts from, row by row and then by rotation.
+
+    @param game the game the perft starts from
+    @param roots set to the list of legal moves
+    @returns the number of legal moves
+*/
+static int list_roots(Game* game, PerftRoot** roots) {
+    Board* board = game->gameBoard;
+    int total = 0;
+    int capacity = 64;
+    *roots = malloc(sizeof(PerftRoot) * capacity);
+    for (int row = -2; row <= board->height + 1; row++) {
+        for (int col = -2; col <= board->width + 1; col++) {
+            for (int rotation = 0; rotation < POSSIBLE_ROTATION;
+                    rotation++) {
+                int move[3] = {row, col, rotation * 90};
+                if (!valid_move(move, board, game->tiles)) {
+                    continue;
+                }
+                if (total == capacity) {
+                    capacity *= 2;
+                    *roots = realloc(*roots, sizeof(PerftRoot) * capacity);
+                }
+                memcpy((*roots)[total].move, move, sizeof(move));
+                (*roots)[total++].nodes = 0;
+            }
+        }
+    }
+    return total;
+}
+
+/*
+    Sets up the position a perft starts from: the tile file followed by
+    either the saved game or the dimension of an empty board.
+
+    @param argn the number of arguments, either three or four
+    @param input the arguments given by the user
+    @param game the game to be set up
+    @returns the ErrorCode of the first argument found to be invalid
+*/
+static ErrorCode setup_perft(int argn, char** input, Game* game) {
+    ErrorCode validTile = validate_tile_file(input[1], game->tiles);
+    if (validTile != NO_ERROR) {
+        return validTile;
+    }
+    if (argn == 3) {
+        return load_saved_game(input[2], game);
+    }
+    return validate_dimension(input[3], input[2], game);
+}
+
+/*
+    Counts every sequence of legal moves of the depth given in the options,
+    where each move places the current tile at a center and rotation and
+    the tile then changes as in change_tiles, e.g. "fitz tiles 10 10 --perft
+    3". The root moves are split between the threads given in the options,
+    and the count of every root move is printed followed by the total and
+    the nodes counted per second. Moves are found from the index of legal
+    moves unless the options ask for every move to be checked with
+    valid_move, which gives the reference counts.
+
+    @param argn the number of arguments, either three or four
+    @param input the tile file and either the saved game or the dimension
+    @param options the options including the depth and number of threads
+    @returns the ErrorCode of any invalid argument or NO_ERROR
+*/
+ErrorCode run_perft(int argn, char** input, Options* options) {
+    if (argn != 3 && argn != 4) {
+        return WRONG_PARAM;
+    }
+    Game* game = initialise_game();
+    ErrorCode validGame = setup_perft(argn, input, game);
+    if (validGame != NO_ERROR) {
+        free_game(game);
+        return validGame;
+    }
+    int threads = options->threads;
+    Perft perft;
+    perft.game = game;
+    perft.depth = options->perft;
+    perft.totalRoots = list_roots(game, &perft.roots);
+    perft.nextRoot = 0;
+    if (!options->naiveMoves) {
+        game->moves = initialise_move_index(game->gameBoard, game->tiles);
+    }
+
+    double started = current_time();
+    PerftWorker workers[MAX_THREADS];
+    pthread_t handles[MAX_THREADS];
+    for (int each = 0; each < threads; each++) {
+        PerftWorker* worker = &workers[each];
+        worker->perft = &perft;
+        worker->board = copy_grid(game->gameBoard);
+        worker->index = game->moves == NULL ? NULL :
+                copy_move_index(game->moves, worker->board);
+        worker->tiles = *game->tiles;
+        worker->turn = game->turn;
+    }
+    // The calling thread counts along with the others
+    for (int each = 1; each < threads; each++) {
+        pthread_create(&handles[each], NULL, perft_worker, &workers[each]);
+    }
+    perft_worker(&workers[0]);
+    for (int each = 1; each < threads; each++) {
+        pthread_join(handles[each], NULL);
+    }
+    double elapsed = current_time() - started;
+
+    long long total = 0;
+    for (int each = 0; each < perft.totalRoots; each++) {
+        PerftRoot* root = &perft.roots[each];
+        printf("%d %d %d: %lld\n", root->move[0], root->move[1],
+                root->move[2], root->nodes);
+        total += root->nodes;
+    }
+    printf("Perft %d: %lld nodes in %.3fs on %d threads (%.0f nodes/s)\n",
+            perft.depth, total, elapsed, threads,
+            elapsed > 0 ? total / elapsed : 0);
+    for (int each = 0; each < threads; each++) {
+        free_move_index(workers[each].index);
+        free_grid(workers[each].board);
+    }
+    free(perft.roots);
+    free_game(game);
+    return NO_ERROR;
+}
@@ -0,0 +1,10 @@
+#ifndef PERFT_H
+#define PERFT_H
+// Deepest perft that can be asked for on the command line
+#define PERFT_MAX_DEPTH 16
+
+#include "definition.h"
+
+ErrorCode run_perft(int, char**, Options*);
+
+#endif
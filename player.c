@@ -1,4 +1,5 @@
 #include "player.h"
+#include "mcts.h"
 
 /* 
     Validates player argument is of right type and sets it to the game object 
@@ -12,10 +13,10 @@
 */
 ErrorCode validate_player_type(char* player1, char* player2, Game* game) {
     int validPlayers = 0;
-    char validType[3][2] = {"h", "1", "2"};
+    char validType[6][2] = {"h", "1", "2", "3", "4", "5"};
 
     // Check for each valid type defined above against both player types given
-    for (int typeIndex = 0; typeIndex < 3; typeIndex++) {
+    for (int typeIndex = 0; typeIndex < 6; typeIndex++) {
         char* currentType = validType[typeIndex];
         PlayerType currentPlayer = typeIndex;
 
@@ -53,6 +54,7 @@ Player* initialise_player(bool firstPlayer) {
     newPlayer->firstPlayer = firstPlayer;
     newPlayer->recentMove[0] = INT_MIN;
     newPlayer->recentMove[1] = INT_MIN;
+    newPlayer->tree = NULL;
     return newPlayer;
 }
 
@@ -63,6 +65,8 @@ Player* initialise_player(bool firstPlayer) {
     @param gameContent object containing game information
 */
 void free_players(Game* gameContent) {
+    free_mcts_tree(gameContent->player1->tree);
+    free_mcts_tree(gameContent->player2->tree);
     free(gameContent->player1);
     free(gameContent->player2);
 }
\ No newline at end of file
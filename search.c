@@ -0,0 +1,608 @@
+#include "search.h"
+#include "grid.h"
+#include "moves.h"
+#include "tiles.h"
+#include "stats.h"
+#include "util.h"
+#include <pthread.h>
+
+/*
+    How the value of a transposition table entry bounds the value of its
+    position: exactly, from below after a beta cutoff or from above when no
+    move raised alpha.
+*/
+typedef enum {
+    BOUND_EXACT,
+    BOUND_LOWER,
+    BOUND_UPPER
+} Bound;
+
+/*
+    An entry of the transposition table, shared without locks by the threads
+    of a search. data packs the value of the position in its low 32 bits,
+    followed by the depth searched, the Bound and the rotation index of the
+    best move, while move packs the row and column of the best move. check
+    is the key of the position XORed with both, so an entry torn by threads
+    writing it at once no longer matches the key.
+*/
+typedef struct {
+    uint64_t check;
+    uint64_t data;
+    uint64_t move;
+} TableEntry;
+
+/*
+    The state of a single thread of an alpha-beta search. Moves are made and
+    taken back on a copy of the board and of its index of legal moves, which
+    shares the bitsets of the index of the game until they change, so the
+    game is left untouched, while hash follows the Zobrist hash of the
+    occupied cells and the current tile. Without an index, a copy of the
+    counts of legal moves kept by the game is followed instead and the moves
+    are found by scanning the board. Every thread of the search shares
+    the table and halt, set once any thread has decided the game, and stops
+    at the deadline. The thread number id picks the order moves are tried
+    in, and move is the best move of the deepest search depth completed.
+*/
+typedef struct {
+    Board* board;
+    MoveIndex* index;
+    MoveCounts* counts;
+    Tiles* tiles;
+    int tile;
+    int turn;
+    uint64_t hash;
+    TableEntry* table;
+    int* halt;
+    int id;
+    int threads;
+    long long nodes;
+    double deadline;
+    bool stopped;
+    int depth;
+    int move[3];
+} SearchState;
+
+/*
+    Gets the Zobrist key of the current tile, taken from the keys of the row
+    above the board which never holds a cell.
+
+    @param tile the index of the tile
+    @returns the key of the tile
+*/
+static uint64_t tile_key(int tile) {
+    return grid_cell_key(-1, tile);
+}
+
+/*
+    Finds the first legal candidate of a tile rotation at or after the given
+    candidate in scan order by scanning the board, without wrapping around.
+
+    @param board the board containing the placements
+    @param shape the tile rotation to be placed
+    @param from the number of the candidate where the scan starts
+    @returns the number of the first legal candidate or -1 if there is none
+*/
+static long long scan_next_move(Board* board, TileShape* shape, 
+        long long from) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    int rows = board->height + 2 * offset;
+    int cols = board->width + 2 * offset;
+    for (int row = from / cols; row < rows; row++) {
+        long long col = legal_row_next(board, shape, row, 
+                row == from / cols ? (int) (from % cols) : 0);
+        if (col >= 0) {
+            return (long long) row * cols + col;
+        }
+    }
+    return -1;
+}
+
+/*
+    Places or removes the cells of a move of the current tile of the search,
+    keeping the index of legal moves, or the counts of moves without one,
+    and the hash up to date.
+
+    @param state the state of the search
+    @param move the row, column and rotation of the move
+    @param place whether the cells are placed or removed
+*/
+static void toggle_move(SearchState* state, int move[3], bool place) {
+    int offset = TILE_GRID_SQR_DIM / 2;
+    TileShape* shape =
+            &state->tiles->list[state->tile].rotations[move[2] / 90];
+    if (state->index == NULL) {
+        update_move_counts(state->counts, state->board, state->tiles, 
+                move[0], move[1], -1);
+    }
+    for (int tileY = shape->top; tileY <= shape->bottom; tileY++) {
+        uint64_t rowMask =
+                shape->mask >> (tileY * TILE_GRID_SQR_DIM) & TILE_ROW_BITS;
+        if (rowMask == 0) {
+            continue;
+        } else if (place) {
+            grid_set_row_bits(state->board, move[0] - offset + tileY,
+                    move[1] - offset, rowMask,
+                    state->board->players[state->turn]);
+        } else {
+            grid_clear_row_bits(state->board, move[0] - offset + tileY,
+                    move[1] - offset, rowMask);
+        }
+    }
+    state->hash ^= grid_shape_key(shape, move[0], move[1]);
+    if (state->index != NULL) {
+        update_move_index(state->index, move[0], move[1]);
+    } else {
+        update_move_counts(state->counts, state->board, state->tiles, 
+                move[0], move[1], 1);
+    }
+}
+
+/*
+    Makes a move of the current tile, moving on to the next tile and turn.
+
+    @param state the state of the search
+    @param move the row, column and rotation of the move
+*/
+static void make_move(SearchState* state, int move[3]) {
+    toggle_move(state, move, true);
+    int next = (state->tile + 1) % state->tiles->total;
+    state->hash ^= tile_key(state->tile) ^ tile_key(next);
+    state->tile = next;
+    state->turn = 1 - state->turn;
+}
+
+/*
+    Takes back a move made by make_move.
+
+    @param state the state of the search
+    @param move the row, column and rotation of the move
+*/
+static void unmake_move(SearchState* state, int move[3]) {
+    int total = state->tiles->total;
+    int previous = (state->tile + total - 1) % total;
+    state->hash ^= tile_key(state->tile) ^ tile_key(previous);
+    state->tile = previous;
+    state->turn = 1 - state->turn;
+    toggle_move(state, move, false);
+}
+
+/*
+    Counts the moves of a tile on the board of the search, the number of
+    legal centers of every distinct rotation of the tile.
+
+    @param state the state of the search
+    @param tile the index of the tile
+    @returns the number of moves
+*/
+static long long mobility(SearchState* state, int tile) {
+    unsigned char* sameRotation = state->tiles->list[tile].sameRotation;
+    long long moves = 0;
+    for (int rotation = 0; rotation < POSSIBLE_ROTATION; rotation++) {
+        if (sameRotation[rotation] != rotation) {
+            continue;
+        } else if (state->index != NULL) {
+            moves += move_index_count(state->index, tile, rotation);
+        } else {
+            moves += state->counts->counts[tile * POSSIBLE_ROTATION + 
+                    rotation];
+        }
+    }
+    return moves;
+}
+
+/*
+    Finds the first legal move of a rotation of the current tile at or after
+    the given candidate in scan order, without wrapping around, from the
+    index when there is one and otherwise by scanning the board.
+
+    @param state the state of the search
+    @param rotation the rotation index of the tile
+    @param from the number of the candidate where the search starts
+    @returns the number of the first legal candidate or -1 if there is none
+*/
+static long long next_move(SearchState* state, int rotation, 
+        long long from) {
+    Board* board = state->board;
+    int offset = TILE_GRID_SQR_DIM / 2;
+    if (from >= (long long) (board->height + 2 * offset) * 
+            (board->width + 2 * offset)) {
+        return -1;
+    } else if (state->index == NULL) {
+        return scan_next_move(board, 
+                &state->tiles->list[state->tile].rotations[rotation], from);
+    }
+    long long found = move_index_next(state->index, state->tile, rotation, 
+            from, true);
+    return found >= from ? found : -1;
+}
+
+/*
+    Converts a value into the value stored in the transposition table, where
+    won and lost positions count the moves from the position rather than
+    from the root.
+
+    @param value the value of the position
+    @param ply the number of moves from the root to the position
+    @returns the value to be stored
+*/
+static int to_table(int value, int ply) {
+    if (value > SEARCH_WIN - 2 * SEARCH_MAX_DEPTH) {
+        return value + ply;
+    } else if (value < 2 * SEARCH_MAX_DEPTH - SEARCH_WIN) {
+        return value - ply;
+    }
+    return value;
+}
+
+/*
+    Converts a value stored in the transposition table back into the value
+    of the position, undoing to_table.
+
+    @param value the value stored
+    @param ply the number of moves from the root to the position
+    @returns the value of the position
+*/
+static int from_table(int value, int ply) {
+    if (value > SEARCH_WIN - 2 * SEARCH_MAX_DEPTH) {
+        return value - ply;
+    } else if (value < 2 * SEARCH_MAX_DEPTH - SEARCH_WIN) {
+        return value + ply;
+    }
+    return value;
+}
+
+/*
+    Looks up the position of the search in the transposition table.
+
+    @param state the state of the search
+    @param value set to the value stored for the position
+    @param depth set to the depth the position was searched to
+    @param bound set to how the value bounds the value of the position
+    @param move set to the best move found for the position
+    @returns whether the table holds an entry for the position
+*/
+static bool probe_table(SearchState* state, int* value, int* depth,
+        int* bound, int move[3]) {
+    TableEntry* entry =
+            &state->table[state->hash & (SEARCH_TABLE_ENTRIES - 1)];
+    uint64_t check = __atomic_load_n(&entry->check, __ATOMIC_RELAXED);
+    uint64_t data = __atomic_load_n(&entry->data, __ATOMIC_RELAXED);
+    uint64_t packed = __atomic_load_n(&entry->move, __ATOMIC_RELAXED);
+    if ((check ^ data ^ packed) != state->hash) {
+        return false;
+    }
+    *value = (int32_t) (uint32_t) data;
+    *depth = (int) (data >> 32 & 0xff);
+    *bound = (int) (data >> 40 & 0x3);
+    move[0] = (int32_t) (uint32_t) packed;
+    move[1] = (int32_t) (uint32_t) (packed >> 32);
+    move[2] = (int) (data >> 42 & 0x3) * 90;
+    return true;
+}
+
+/*
+    Stores the result of searching the position of the search in the
+    transposition table, replacing whatever the entry held.
+
+    @param state the state of the search
+    @param value the value to be stored
+    @param depth the depth the position was searched to
+    @param bound how the value bounds the value of the position
+    @param move the best move found for the position
+*/
+static void store_table(SearchState* state, int value, int depth, int bound,
+        int move[3]) {
+    TableEntry* entry =
+            &state->table[state->hash & (SEARCH_TABLE_ENTRIES - 1)];
+    uint64_t data = (uint32_t) value | (uint64_t) depth << 32 |
+            (uint64_t) bound << 40 | (uint64_t) (move[2] / 90) << 42;
+    uint64_t packed = (uint32_t) move[0] | (uint64_t) (uint32_t) move[1] <<
+            32;
+    __atomic_store_n(&entry->check, state->hash ^ data ^ packed,
+            __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->data, data, __ATOMIC_RELAXED);
+    __atomic_store_n(&entry->move, packed, __ATOMIC_RELAXED);
+}
+
+static int search_node(SearchState*, int, int, int, int, int*);
+
+/*
+    Searches the position after a move, keeping the best value and move of
+    the position and raising alpha.
+
+    @param state the state of the search
+    @param move the row, column and rotation of the move
+    @param depth the depth left at the position before the move
+    @param alpha the value the player is already sure of, raised in place
+    @param beta the value above which the opponent avoids the position
+    @param ply the number of moves from the root to the position
+    @param best the best value found so far, updated in place
+    @param bestMove the best move found so far, updated in place
+    @returns whether the position needs no further search, either after a
+    cutoff or as the time has run out
+*/
+static bool search_child(SearchState* state, int move[3], int depth,
+        int* alpha, int beta, int ply, int* best, int bestMove[3]) {
+    int reply[3];
+    make_move(state, move);
+    int value = -search_node(state, depth - 1, -beta, -*alpha, ply + 1,
+            reply);
+    unmake_move(state, move);
+    if (state->stopped) {
+        return true;
+    }
+    if (value > *best) {
+        *best = value;
+        memcpy(bestMove, move, sizeof(int) * 3);
+    }
+    if (value > *alpha) {
+        *alpha = value;
+    }
+    return *alpha >= beta;
+}
+
+/*
+    Searches a position with alpha-beta to the given depth. A player without
+    any move has lost, and at the depth reached a position is valued by the
+    moves left to the player less the moves left to the opponent with the
+    tile after. The move stored for the position in the transposition table
+    is searched first, then every other move. Each thread of the search
+    starts from a different rotation and position, so the threads spread
+    over different parts of the tree.
+
+    @param state the state of the search
+    @param depth the number of moves left to be searched
+    @param alpha the value the player is already sure of
+    @param beta the value above which the opponent avoids the position
+    @param ply the number of moves from the root to the position
+    @param bestMove set to the best move found, kept when none is found
+    @returns the value of the position for the player to move
+*/
+static int search_node(SearchState* state, int depth, int alpha, int beta,
+        int ply, int* bestMove) {
+    if (++state->nodes % SEARCH_CHECK_NODES == 0 &&
+            (current_time() >= state->deadline ||
+            __atomic_load_n(state->halt, __ATOMIC_RELAXED))) {
+        state->stopped = true;
+    }
+    if (state->stopped) {
+        return 0;
+    }
+    long long moves = mobility(state, state->tile);
+    if (moves == 0) {
+        return ply - SEARCH_WIN;
+    }
+    // The moves of a large board without an index can pass a win, so the
+    // value is capped below one
+    if (depth == 0) {
+        long long value = moves - mobility(state, (state->tile + 1) %
+                state->tiles->total);
+        value = value > SEARCH_MAX_VALUE ? SEARCH_MAX_VALUE : value;
+        return (int) (value < -SEARCH_MAX_VALUE ? -SEARCH_MAX_VALUE : value);
+    }
+
+    int tableMove[3] = {0, 0, -1};
+    int stored[3];
+    int value;
+    int storedDepth;
+    int bound;
+    if (probe_table(state, &value, &storedDepth, &bound, stored)) {
+        value = from_table(value, ply);
+        if (storedDepth >= depth && (bound == BOUND_EXACT ||
+                (bound == BOUND_LOWER && value >= beta) ||
+                (bound == BOUND_UPPER && value <= alpha))) {
+            memcpy(bestMove, stored, sizeof(stored));
+            return value;
+        }
+        // The move is checked as different positions can share a key
+        TileShape* shape = &state->tiles->list[state->tile].
+                rotations[stored[2] / 90];
+        if (legal_centers(state->board, shape, stored[0], stored[1]) & 1) {
+            memcpy(tableMove, stored, sizeof(tableMove));
+        }
+    }
+
+    int startAlpha = alpha;
+    int best = -SEARCH_WIN - 1;
+    bool done = tableMove[2] >= 0 && search_child(state, tableMove, depth,
+            &alpha, beta, ply, &best, bestMove);
+    int offset = TILE_GRID_SQR_DIM / 2;
+    unsigned char* sameRotation = state->tiles->list[state->tile].sameRotation;
+    long long cols = state->board->width + 2 * offset;
+    long long total = (state->board->height + 2 * offset) * cols;
+    long long start = total / state->threads * state->id;
+    for (int turn = 0; turn < POSSIBLE_ROTATION && !done; turn++) {
+        int rotation = (turn + state->id) % POSSIBLE_ROTATION;
+        if (sameRotation[rotation] != rotation) {
+            continue;
+        }
+        // The candidates from the start onwards, then those before it
+        for (int part = 0; part < 2 && !done; part++) {
+            long long end = part == 0 ? total : start;
+            long long candidate = next_move(state, rotation, 
+                    part == 0 ? start : 0);
+            while (candidate >= 0 && candidate < end && !done) {
+                int move[3] = {
+                    candidate / cols - offset,
+                    candidate % cols - offset,
+                    rotation * 90
+                };
+                if (memcmp(move, tableMove, sizeof(move)) != 0) {
+                    done = search_child(state, move, depth, &alpha, beta, 
+                            ply, &best, bestMove);
+                }
+                candidate = next_move(state, rotation, candidate + 1);
+            }
+        }
+    }
+    if (state->stopped) {
+        return 0;
+    }
+
+    store_table(state, to_table(best, ply), depth, best >= beta ?
+            BOUND_LOWER : best > startAlpha ? BOUND_EXACT : BOUND_UPPER,
+            bestMove);
+    return best;
+}
+
+/*
+    Runs a thread of the search with iterative deepening, searching one move
+    deeper at a time until the time has run out or the game is decided.
+    Every other thread starts a move deeper, so the threads rarely search
+    the same depth at once. The best move of the first search is kept even
+    if it was cut short.
+
+    @param data the state of the thread
+    @returns nothing
+*/
+static void* search_worker(void* data) {
+    SearchState* state = data;
+    for (int depth = 1 + state->id % 2; depth <= SEARCH_MAX_DEPTH; depth++) {
+        int move[3];
+        memcpy(move, state->move, sizeof(move));
+        int value = search_node(state, depth, -SEARCH_WIN - 1,
+                SEARCH_WIN + 1, 0, move);
+        if (!state->stopped || state->depth == 0) {
+            memcpy(state->move, move, sizeof(move));
+        }
+        if (state->stopped) {
+            break;
+        }
+        state->depth = depth;
+        // Once the game is decided a deeper search gives nothing more
+        if (value > SEARCH_WIN - SEARCH_MAX_DEPTH ||
+                value < SEARCH_MAX_DEPTH - SEARCH_WIN) {
+            __atomic_store_n(state->halt, 1, __ATOMIC_RELAXED);
+            break;
+        }
+    }
+    STATS_FLUSH();
+    return NULL;
+}
+
+/*
+    Searches the move of a searching player on the given number of threads
+    sharing a transposition table, each with its own copy of the board and
+    index. The move of the thread that completed the deepest search is made.
+    When the index of legal moves would be too large, the counts of legal
+    moves kept by the game are followed instead, while the moves are found
+    by scanning. The counts are made within the time of the move, over as
+    many moves as counting the board takes, and until they are complete the
+    move already found by the scan of the player is kept. The threads are
+    set up within the time of the move too, and no more are set up than
+    have copies of the board within SEARCH_COPY_BYTES.
+
+    @param game contains the board, tiles, index and options
+    @param search the search of the player, which has found a legal move
+    @param threads the number of threads searching
+    @param report whether the nodes searched by every thread are printed
+*/
+static void run_search(Game* game, MoveSearch* search, int threads,
+        bool report) {
+    double started = current_time();
+    double deadline = started + game->options.moveTime / 1000.0;
+    if (game->moves == NULL) {
+        if (game->counts == NULL) {
+            game->counts = initialise_move_counts(game->tiles);
+        }
+        if (!build_move_counts(game->counts, game->gameBoard, game->tiles,
+                deadline)) {
+            if (report) {
+                printf("Search threads: %d of %d tile rotations counted\n",
+                        game->counts->ready, game->counts->total);
+            }
+            return;
+        }
+    }
+    size_t copyBytes = grid_bytes(game->gameBoard);
+    if ((size_t) threads * copyBytes > SEARCH_COPY_BYTES) {
+        threads = SEARCH_COPY_BYTES / copyBytes > 1 ? 
+                SEARCH_COPY_BYTES / copyBytes : 1;
+    }
+    TableEntry* table = calloc(SEARCH_TABLE_ENTRIES, sizeof(TableEntry));
+    int halt = 0;
+    uint64_t hash = game->hash ^ tile_key(game->tiles->current);
+    SearchState* states = malloc(sizeof(SearchState) * threads);
+    pthread_t handles[MAX_THREADS];
+    for (int each = 0; each < threads; each++) {
+        // Threads past the first are only set up while there is time left
+        if (each > 0 && current_time() >= deadline) {
+            threads = each;
+            break;
+        }
+        SearchState* state = &states[each];
+        state->board = copy_grid(game->gameBoard);
+        state->index = copy_move_index(game->moves, state->board);
+        state->counts = game->moves == NULL ? 
+                copy_move_counts(game->counts) : NULL;
+        state->tiles = game->tiles;
+        state->tile = game->tiles->current;
+        state->turn = game->turn;
+        state->hash = hash;
+        state->table = table;
+        state->halt = &halt;
+        state->id = each;
+        state->nodes = 0;
+        state->deadline = deadline;
+        state->stopped = false;
+        state->depth = 0;
+        memcpy(state->move, search->move, sizeof(state->move));
+    }
+    for (int each = 0; each < threads; each++) {
+        states[each].threads = threads;
+    }
+    // The calling thread searches along with the others
+    for (int each = 1; each < threads; each++) {
+        pthread_create(&handles[each], NULL, search_worker, &states[each]);
+    }
+    search_worker(&states[0]);
+    for (int each = 1; each < threads; each++) {
+        pthread_join(handles[each], NULL);
+    }
+
+    double elapsed = current_time() - started;
+    SearchState* deepest = &states[0];
+    for (int each = 0; each < threads; each++) {
+        SearchState* state = &states[each];
+        if (state->depth > deepest->depth) {
+            deepest = state;
+        }
+        if (report) {
+            printf("Search thread %d: %lld nodes to depth %d (%.0f "
+                    "nodes/s)\n", each, state->nodes, state->depth,
+                    elapsed > 0 ? state->nodes / elapsed : 0);
+        }
+        free_move_index(state->index);
+        free_move_counts(state->counts);
+        free_grid(state->board);
+    }
+    memcpy(search->move, deepest->move, sizeof(deepest->move));
+    free(states);
+    free(table);
+}
+
+/*
+    Chooses the move of a Type 3 player with iterative deepening alpha-beta
+    on a single thread, for the time given by the options.
+
+    @param game contains the board, tiles, index and options
+    @param search the search of the player, which has found a legal move
+*/
+void search_move(Game* game, MoveSearch* search) {
+    run_search(game, search, 1, false);
+}
+
+/*
+    Chooses the move of a Type 5 player with Lazy SMP, running the search
+    on the number of threads given by the options for the time given by
+    the options. The nodes searched per second by every thread are printed
+    unless the game is headless, and always when more than one thread was
+    asked for.
+
+    @param game contains the board, tiles, index and options
+    @param search the search of the player, which has found a legal move
+*/
+void parallel_search_move(Game* game, MoveSearch* search) {
+    run_search(game, search, game->options.threads,
+            !game->options.headless || game->options.threads > 1);
+}
@@ -0,0 +1,24 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+// Time in milliseconds a searching player takes for a move by default
+#define SEARCH_MOVE_TIME 100
+// Entries of the transposition table of a search, a power of two
+#define SEARCH_TABLE_ENTRIES (1 << 16)
+// Deepest search in moves
+#define SEARCH_MAX_DEPTH 64
+// Nodes searched between checks of the time
+#define SEARCH_CHECK_NODES 64
+// Score of a won position, less the number of moves taken to win it
+#define SEARCH_WIN (1 << 30)
+// Most bytes of the copies of the board made for the threads of a search
+#define SEARCH_COPY_BYTES (256 * 1024 * 1024)
+// Largest value of a position that is not decided, well below a win
+#define SEARCH_MAX_VALUE (SEARCH_WIN / 2)
+
+#include "definition.h"
+
+void search_move(Game*, MoveSearch*);
+
+void parallel_search_move(Game*, MoveSearch*);
+
+#endif
@@ -0,0 +1,86 @@
+#include "stats.h"
+
+#ifdef FITZ_STATS
+/*
+    The counters of every thread, only ever touched by that thread so
+    counting costs no more than an addition.
+*/
+__thread Stats threadStats;
+#endif
+
+/* The counters of every thread that has flushed them */
+static Stats totalStats;
+
+/* Where the counters are reported at exit, "-" for the standard output */
+static char* statsPath;
+
+/*
+    Adds the counters of the calling thread to the totals and clears them,
+    so the counts of a worker thread are kept once it exits.
+*/
+void flush_stats(void) {
+#ifdef FITZ_STATS
+    // Every counter is a long long, so they are added as an array
+    long long* from = (long long*) &threadStats;
+    long long* to = (long long*) &totalStats;
+    for (size_t each = 0; each < sizeof(Stats) / sizeof(long long); each++) {
+        __atomic_fetch_add(&to[each], from[each], __ATOMIC_RELAXED);
+        from[each] = 0;
+    }
+#endif
+}
+
+/*
+    Writes the counters as JSON to the path given to start_stats. Every
+    counter is zero when the counters were compiled out.
+*/
+static void report_stats(void) {
+    flush_stats();
+    FILE* out = strcmp(statsPath, "-") == 0 ? stdout : 
+            fopen(statsPath, "w");
+    if (out == NULL) {
+        fprintf(stderr, "Unable to write stats\n");
+        return;
+    }
+    Stats* stats = &totalStats;
+#ifdef FITZ_STATS
+    bool enabled = true;
+#else
+    bool enabled = false;
+#endif
+    fprintf(out, "{\n  \"enabled\": %s,\n", enabled ? "true" : "false");
+    fprintf(out, "  \"find_move\": {\"searches\": %lld, \"index_lookups\": "
+            "%lld, \"index_words_scanned\": %lld, \"candidates_scanned\": "
+            "%lld},\n", stats->moveSearches, stats->indexLookups, 
+            stats->indexWordsScanned, stats->candidatesScanned);
+    fprintf(out, "  \"legal_center_run_words\": %lld,\n", 
+            stats->legalRunWords);
+    fprintf(out, "  \"update_move_index\": {\"rows_tested\": %lld, "
+            "\"words_updated\": %lld},\n", stats->indexRowsTested, 
+            stats->indexWordsUpdated);
+    fprintf(out, "  \"valid_move\": {\"calls\": %lld, \"cells_probed\": "
+            "%lld},\n", stats->validMoveCalls, stats->validMoveCells);
+    fprintf(out, "  \"moves\": {\"human\": %lld", stats->moves[HUMAN]);
+    for (int type = P1_AUTO; type <= P5_AUTO; type++) {
+        fprintf(out, ", \"type%d\": %lld", type, stats->moves[type]);
+    }
+    fprintf(out, "},\n  \"bytes_rendered\": %lld,\n", stats->bytesRendered);
+    fprintf(out, "  \"bytes_read\": {\"tiles\": %lld, \"saves\": %lld}\n}\n",
+            stats->tileBytesRead, stats->saveBytesRead);
+    if (out == stdout) {
+        fflush(out);
+    } else {
+        fclose(out);
+    }
+}
+
+/*
+    Reports the counters at exit to the given path, or to the standard
+    output when the path is "-".
+
+    @param path where the counters are reported
+*/
+void start_stats(char* path) {
+    statsPath = path;
+    atexit(report_stats);
+}
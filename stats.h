@@ -0,0 +1,21 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include "definition.h"
+
+#ifdef FITZ_STATS
+extern __thread Stats threadStats;
+// Adds to a counter of the calling thread
+#define STATS_ADD(counter, amount) (threadStats.counter += (amount))
+// Adds the counters of the calling thread to the totals, before it exits
+#define STATS_FLUSH() flush_stats()
+#else
+#define STATS_ADD(counter, amount) ((void) 0)
+#define STATS_FLUSH() ((void) 0)
+#endif
+
+void flush_stats(void);
+
+void start_stats(char*);
+
+#endif
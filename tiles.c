@@ -1,10 +1,30 @@
 #include "tiles.h"
 #include "parser.h"
+#include "util.h"
+#include "stats.h"
+#include <fcntl.h>
+#include <pthread.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*
+    A range of the tiles of a tile file parsed by a single worker, along with
+    whether every tile of the range was valid.
+*/
+typedef struct {
+    const char* text;
+    Tile* list;
+    int first;
+    int last;
+    int total;
+    bool valid;
+} TileRange;
 
 /*
     Initialises the tile list that loads all the tiles with their respective
-    rotations. By default it contains four rows corresponding to possible
-    rotations: 0, 90, 180, 270
+    rotations. Every tile holds its four rotations: 0, 90, 180, 270
     
     @returns a tile list that holds a tile and its corresponding rotation
     tiles
@@ -13,107 +33,174 @@ Tiles* initialise_tile_list(void) {
     // initialise default values of the tile structure
     Tiles* newTile = malloc(sizeof(Tiles));
     newTile->total = 0;
+    newTile->capacity = 0;
     newTile->current = 0;
     newTile->rotationIndex = 0;
-    newTile->grid = malloc(sizeof(int***) * TOTAL_ROTATION);
+    newTile->list = NULL;
     return newTile;
 }
 
+/*
+    Makes room for at least the given number of tiles in the list, doubling
+    its size so that adding tiles one at a time takes about log n
+    allocations.
+
+    @param tileList the tile list to be grown
+    @param needed the number of tiles the list must be able to hold
+*/
+static void reserve_tiles(Tiles* tileList, int needed) {
+    if (needed <= tileList->capacity) {
+        return;
+    }
+    int capacity = tileList->capacity > 0 ? tileList->capacity : 
+            INITIAL_TILE_CAPACITY;
+    while (capacity < needed) {
+        capacity *= 2;
+    }
+    tileList->list = realloc(tileList->list, sizeof(Tile) * capacity);
+    tileList->capacity = capacity;
+}
+
 /*
     Initialises a tile along with its rotation version containing an empty
-    5x5 grid by default
+    5x5 grid by default.
 
     @param tileList the tile on which the new tiles must be placed
 */
 void initialise_new_tile(Tiles* tileList) {
+    reserve_tiles(tileList, tileList->total + 1);
     // Increasing total tile length by 1
     int tileIndex = tileList->total++;
-    for(int rotationIndex = 0; rotationIndex < TOTAL_ROTATION; 
-            rotationIndex++) {
-        // Allocating memory for the tile
-        // Can use realloc only but that seems to bring few errors
-        // Just pleasing valgrind
-        if(tileIndex == 0) {
-            tileList->grid[rotationIndex] = malloc(sizeof(int**));
-        } else {
-            tileList->grid[rotationIndex] = realloc(
-                    tileList->grid[rotationIndex], 
-                    sizeof(int**) * tileList->total
-                    );
+    // Every rotation of the new tile starts without any placeable position
+    memset(&tileList->list[tileIndex], 0, sizeof(Tile));
+}
+
+/*
+    Frees the tile list along with all the tiles and their rotations.
+
+    @param tileList tileList the tile on which the tiles must be freed
+*/
+void free_tiles(Tiles* tileList) {
+    // All the rotations are stored within the tiles themselves
+    free(tileList->list);
+    // Finally freeing the tile list
+    free(tileList);
+}
+
+/*
+    Computes the bounding box and the list of placeable cells of a tile
+    rotation from its mask.
+
+    @param shape the tile rotation whose mask has been assigned
+*/
+static void compile_tile_shape(TileShape* shape) {
+    shape->top = TILE_GRID_SQR_DIM;
+    shape->bottom = -1;
+    shape->left = TILE_GRID_SQR_DIM;
+    shape->right = -1;
+    shape->cellCount = 0;
+    for (int rows = 0; rows < TILE_GRID_SQR_DIM; rows++) {
+        for (int cols = 0; cols < TILE_GRID_SQR_DIM; cols++) {
+            int cell = rows * TILE_GRID_SQR_DIM + cols;
+            if (!(shape->mask >> cell & 1)) {
+                continue;
+            }
+            // Growing the box to contain the placeable cell
+            if (rows < shape->top) {
+                shape->top = rows;
+            }
+            shape->bottom = rows;
+            if (cols < shape->left) {
+                shape->left = cols;
+            }
+            if (cols > shape->right) {
+                shape->right = cols;
+            }
+            shape->cells[shape->cellCount++] = cell;
         }
-        int*** rotations = tileList->grid[rotationIndex];
-        // Selecting the tile index and allocating memory for rows
-        rotations[tileIndex] = malloc(sizeof(int*) * TILE_GRID_SQR_DIM);
-        int** currentTile = rotations[tileIndex];
-        // Allocating memory for each cols
+    }
+}
+
+/*
+    Takes the zero rotated tile and applies the algorithm to copy it into
+    all the possible rotations, then compiles every rotation and finds the
+    rotations with the same shape
+
+    @param tile the tile whose zero degree rotation has been assigned
+*/
+static void rotate_single_tile(Tile* tile) {
+    TileShape* rotations = tile->rotations;
+    // Needs to make a rotated copy of the tile using the previous degree
+    for(int rotateIndex = 1; rotateIndex < TOTAL_ROTATION; rotateIndex++) {
+        uint32_t lastDegree = rotations[rotateIndex - 1].mask;
+        uint32_t rotated = 0;
+        // Since it is always going to be a square grid 
         for(int rows = 0; rows < TILE_GRID_SQR_DIM; rows++) {
-            currentTile[rows] = malloc(sizeof(int) * TILE_GRID_SQR_DIM);
-            int* currentRow = currentTile[rows];
             for(int cols = 0; cols < TILE_GRID_SQR_DIM; cols++) {
-                currentRow[cols] = 0;
+                // The rows become the column but on the opposite direction
+                // i.e. Top to bottom of the previous degree tile becomes
+                // Right to left for the current degree
+                uint32_t placeable = 
+                        lastDegree >> (rows * TILE_GRID_SQR_DIM + cols) & 1;
+                rotated |= placeable << (cols * TILE_GRID_SQR_DIM + 
+                        TILE_GRID_SQR_DIM - 1 - rows);
             }
         }
+        rotations[rotateIndex].mask = rotated;
+    }
+    for(int rotateIndex = 0; rotateIndex < TOTAL_ROTATION; rotateIndex++) {
+        compile_tile_shape(&rotations[rotateIndex]);
+        // Finding the lowest rotation with the same shape
+        int same = 0;
+        while (rotations[same].mask != rotations[rotateIndex].mask) {
+            same++;
+        }
+        tile->sameRotation[rotateIndex] = same;
     }
 }
 
 /*
-    Frees the tile list and all the rotated version of the tiles going 
-    by rotation, by tile and then by each rows.
+    Finds the lowest tile with the same shape as every tile, using a hash
+    table of the shapes seen so far.
 
-    @param tileList tileList the tile on which the tiles must be freed
+    @param tiles the tile list whose rotations have been compiled
 */
-void free_tiles(Tiles* tileList) {
-    int**** rotateList = tileList->grid;
-    for(int eachRotate = 0; eachRotate < TOTAL_ROTATION; eachRotate++) {
-        int*** currentRotation = rotateList[eachRotate];
-        for(int eachTile = 0; eachTile < tileList->total; eachTile++) {
-            int** tileGrid = currentRotation[eachTile];
-            for(int eachRow = 0; eachRow < TILE_GRID_SQR_DIM; eachRow++) {
-                int* eachCol = tileGrid[eachRow];
-                // Free each col
-                free(eachCol);
-            }
-            // Freeing each tile grid
-            free(tileGrid);
+static void intern_tiles(Tiles* tiles) {
+    int bits = 1;
+    while (((size_t) 1 << bits) < (size_t) tiles->total * 2) {
+        bits++;
+    }
+    size_t size = (size_t) 1 << bits;
+    // Holds one more than the index of a tile, or zero when unused
+    int* table = calloc(size, sizeof(int));
+    for (int tileIndex = 0; tileIndex < tiles->total; tileIndex++) {
+        Tile* tile = &tiles->list[tileIndex];
+        uint32_t mask = tile->rotations[0].mask;
+        size_t slot = (mask * TILE_HASH_MULTIPLIER) >> (64 - bits);
+        while (table[slot] != 0 && 
+                tiles->list[table[slot] - 1].rotations[0].mask != mask) {
+            slot = (slot + 1) & (size - 1);
+        }
+        if (table[slot] == 0) {
+            table[slot] = tileIndex + 1;
         }
-        // Freeing each 
-        free(currentRotation);
+        tile->sameTile = table[slot] - 1;
     }
-    // Freeing all the rotation of a tile
-    free(rotateList);
-    // Finally freeing the tile list
-    free(tileList);
+    free(table);
 }
 
 /*
-    Takes the zero rotated tile and applies the algorithm to copy it into
-    all the possible rotations
+    Copies the zero rotated version of every tile into all the possible
+    rotations, then finds the tiles and rotations sharing the same shape.
     
     @param tiles the tile list that got initialised before assigning the 
     zero degree tile
 */
 void rotate_tile(Tiles* tiles) {
-    // Needs to make a rotated copy of all the tiles using the zero degree
-    // tile
-    for(int rotateIndex = 1; rotateIndex < TOTAL_ROTATION; rotateIndex++) {
-        int*** lastDegree = tiles->grid[rotateIndex - 1];
-        int*** otherTiles = tiles->grid[rotateIndex];
-        // For each tiles in the rotation index
-        for(int tileIndex = 0; tileIndex < tiles->total; tileIndex++) {
-            int** otherTilesIndex = otherTiles[tileIndex];
-            int** lastDegreeTilesIndex = lastDegree[tileIndex];
-            // Since it is always going to be a square grid 
-            for(int rows = 0; rows < TILE_GRID_SQR_DIM; rows++) {
-                for(int cols = 0; cols < TILE_GRID_SQR_DIM; cols++) {
-                    // The rows become the column but on the opposite direction
-                    // i.e. Top to bottom of the previous degree tile becomes
-                    // Right to left for the current degree
-                    otherTilesIndex[cols][TILE_GRID_SQR_DIM - 1 - rows] =
-                            lastDegreeTilesIndex[rows][cols]; 
-                }
-            }
-        }
+    for(int tileIndex = 0; tileIndex < tiles->total; tileIndex++) {
+        rotate_single_tile(&tiles->list[tileIndex]);
     }
+    intern_tiles(tiles);
 }
 
 /*
@@ -127,7 +214,7 @@ void rotate_tile(Tiles* tiles) {
 */
 void display_tiles(Tiles* tile, bool onlyCurrent) {
     int totalTiles = tile->total;
-    int**** tileList = tile->grid;
+    Tile* tileList = tile->list;
     int currentIndex = tile->current;
     // For each tile in the array
     for (int tileIndex = 0; tileIndex < totalTiles; tileIndex++) {
@@ -143,7 +230,8 @@ void display_tiles(Tiles* tile, bool onlyCurrent) {
                 // For each column
                 for (int cols = 0; cols < TILE_GRID_SQR_DIM; cols++) {
                     // If the position is placeable
-                    if (tileList[index][tileIndex][rows][cols]) {
+                    uint32_t mask = tileList[tileIndex].rotations[index].mask;
+                    if (mask >> (rows * TILE_GRID_SQR_DIM + cols) & 1) {
                         printf("!");
                     } else {
                         printf(",");
@@ -204,21 +292,22 @@ ErrorCode show_only_tiles(char* fileName, Tiles* tiles) {
     @param col the column of the current position being parsed and validated to
     be within bounds
     @param character the current value being read in the iteration
-    @param tile contains the content on which the proper characters are 
+    @param tile contains the mask on which the proper characters are 
     translated as placeable position or not.
     @returns boolean whether the validation was successful
 */
 bool validate_current_position(int row, int col, int character, 
-        int** tile) {
+        TileShape* tile) {
     // If the row and column exceeds the dimension of the tile grid
     if (row >= TILE_GRID_SQR_DIM || col >= TILE_GRID_SQR_DIM) {
         return false;
     } 
     // If the character is not acceptable     
+    uint32_t cell = (uint32_t) 1 << (row * TILE_GRID_SQR_DIM + col);
     if (character == ',') {
-        tile[row][col] = 0;
+        tile->mask &= ~cell;
     } else if (character == '!') {
-        tile[row][col] = 1;
+        tile->mask |= cell;
     } else {
         return false;
     } 
@@ -226,9 +315,151 @@ bool validate_current_position(int row, int col, int character,
     return true;
 }
 
+/*
+    Parses a single tile of a tile file into its zero degree rotation. A tile
+    is five rows of five ',' or '!' characters, each row followed by a line
+    termination. With SSE2 the 30 characters are classified 16 at a time,
+    otherwise character by character.
+
+    @param text the first character of the tile
+    @param tile the rotation on which the placeable positions are set
+    @returns whether the tile is valid
+*/
+static bool parse_tile_text(const char* text, TileShape* tile) {
+#ifdef __SSE2__
+    // Two overlapping loads cover the 30 characters of the tile
+    __m128i low = _mm_loadu_si128((const __m128i*) text);
+    __m128i high = _mm_loadu_si128((const __m128i*) (text + 
+            TILE_TEXT_SIZE - 16));
+    __m128i lines = _mm_set1_epi8('\n');
+    __m128i places = _mm_set1_epi8('!');
+    __m128i blanks = _mm_set1_epi8(',');
+    int shift = TILE_TEXT_SIZE - 16;
+    uint32_t lineBits = _mm_movemask_epi8(_mm_cmpeq_epi8(low, lines)) |
+            (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(high, lines)) << shift;
+    uint32_t placeBits = _mm_movemask_epi8(_mm_cmpeq_epi8(low, places)) |
+            (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(high, places)) << 
+            shift;
+    uint32_t blankBits = _mm_movemask_epi8(_mm_cmpeq_epi8(low, blanks)) |
+            (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(high, blanks)) << 
+            shift;
+    // Every row ends in a line termination and has nothing else but
+    // acceptable characters
+    if (lineBits != TILE_LINE_BITS || 
+            (lineBits | placeBits | blankBits) != TILE_TEXT_BITS) {
+        return false;
+    }
+    // Dropping the line terminations from between the rows
+    for (int row = 0; row < TILE_GRID_SQR_DIM; row++) {
+        tile->mask |= (placeBits >> (row * (TILE_GRID_SQR_DIM + 1)) & 
+                TILE_ROW_BITS) << (row * TILE_GRID_SQR_DIM);
+    }
+    return true;
+#else
+    for (int row = 0; row < TILE_GRID_SQR_DIM; row++) {
+        const char* line = text + row * (TILE_GRID_SQR_DIM + 1);
+        if (line[TILE_GRID_SQR_DIM] != '\n') {
+            return false;
+        }
+        for (int col = 0; col < TILE_GRID_SQR_DIM; col++) {
+            if (!validate_current_position(row, col, line[col], tile)) {
+                return false;
+            }
+        }
+    }
+    return true;
+#endif
+}
+
+/*
+    Parses and rotates a range of the tiles of a tile file, where every tile
+    but the last is followed by an empty line.
+
+    @param data the range of tiles to be parsed, whose validity is set
+    @returns nothing
+*/
+static void* parse_tile_range(void* data) {
+    TileRange* range = data;
+    range->valid = true;
+    for (int index = range->first; index < range->last; index++) {
+        const char* text = range->text + (size_t) index * TILE_TEXT_STRIDE;
+        Tile* tile = &range->list[index];
+        memset(tile, 0, sizeof(Tile));
+        if (!parse_tile_text(text, &tile->rotations[0]) || 
+                (index < range->total - 1 && text[TILE_TEXT_SIZE] != '\n')) {
+            range->valid = false;
+            break;
+        }
+        rotate_single_tile(tile);
+    }
+    return NULL;
+}
+
+/*
+    Parses the tiles of a tile file held in memory into the tile list. Since
+    every tile takes the same number of characters, the tiles of a large file
+    are split between worker threads without having to be read first.
+
+    @param text the content of the tile file
+    @param size the number of characters in the content
+    @param tiles object on which the parsed tiles are added
+    @returns whether every tile of the file is valid
+*/
+static bool parse_tile_text_file(const char* text, size_t size, 
+        Tiles* tiles) {
+    // The tiles are separated by a single empty line
+    if (size < TILE_TEXT_SIZE || (size - TILE_TEXT_SIZE) % 
+            TILE_TEXT_STRIDE != 0) {
+        return false;
+    }
+    int total = (size - TILE_TEXT_SIZE) / TILE_TEXT_STRIDE + 1;
+    int first = tiles->total;
+    reserve_tiles(tiles, first + total);
+    tiles->total = first + total;
+
+    // Every thread is given at least PARALLEL_TILE_BYTES of the file
+    long threads = size / PARALLEL_TILE_BYTES;
+    if (threads > 1) {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads = threads < processors ? threads : processors;
+        threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+    }
+    if (threads < 1) {
+        threads = 1;
+    }
+    TileRange ranges[MAX_THREADS];
+    pthread_t handles[MAX_THREADS];
+    for (int worker = 0; worker < threads; worker++) {
+        TileRange* range = &ranges[worker];
+        range->text = text;
+        range->list = tiles->list + first;
+        range->total = total;
+        range->first = (long long) total * worker / threads;
+        range->last = (long long) total * (worker + 1) / threads;
+        // A single range is parsed without starting a thread
+        if (threads == 1) {
+            parse_tile_range(range);
+        } else {
+            pthread_create(&handles[worker], NULL, parse_tile_range, range);
+        }
+    }
+    bool valid = true;
+    for (int worker = 0; worker < threads; worker++) {
+        if (threads > 1) {
+            pthread_join(handles[worker], NULL);
+        }
+        valid = valid && ranges[worker].valid;
+    }
+    if (valid) {
+        intern_tiles(tiles);
+    }
+    return valid;
+}
+
 /*
     Reads the given file and validates the dimension, and the content while
     converting the content into tile object and rotates all the parsed tiles.
+    The file is mapped into memory rather than read where possible.
 
     @param fileName the path or file to access the tiles
     @param tiles object on which the parsed content is reflected
@@ -236,55 +467,19 @@ bool validate_current_position(int row, int col, int character,
     or parsed correctly
 */
 ErrorCode validate_tile_file(char* fileName, Tiles* tiles) {
-    FILE* reader = fopen(fileName, "r");
-    if (reader == NULL) {
+    int descriptor = open(fileName, O_RDONLY);
+    if (descriptor < 0) {
         return TILE_NOT_FOUND;
     }
-    // Defining 
-    int character = '\0';
-    bool lineTerminated = false;
-    initialise_new_tile(tiles);    
-    int row = 0;
-    int col = 0;
-    int** tile = tiles->grid[0][tiles->total - 1];
-    while (true) {
-        character = fgetc(reader);
-        if (feof(reader)) {
-            // If there is a short row then it is invalid
-            if (row < TILE_GRID_SQR_DIM) {
-                return TILE_INVALID;
-            }
-            break;
-        } else if (character == '\n') {
-            if (lineTerminated) {
-                // If there is any subsequent line terminations
-                // New Tile is created if valid row is detected
-                if (row < TILE_GRID_SQR_DIM) {
-                    return TILE_INVALID;
-                } 
-                initialise_new_tile(tiles);
-                row = 0;
-                col = 0;
-                //Changing the current tile 
-                tile = tiles->grid[0][tiles->total - 1];            
-            } else {
-                if(col < TILE_GRID_SQR_DIM) {
-                    return TILE_INVALID; // If the col is lesser than necessary
-                }
-                col = 0;
-                row++;
-            }  
-            lineTerminated = true;
-            continue;
-        } else if (!validate_current_position(row, col, character, tile)) {
-            return TILE_INVALID;
-        }
-        col++;
-        lineTerminated = false;   
-    }
-    rotate_tile(tiles); // Calls the rotate function to create rotate copies
-    fclose(reader);
-    return NO_ERROR;
+    size_t size;
+    bool mapped;
+    char* text = read_file(descriptor, &size, &mapped);
+    close(descriptor);
+    STATS_ADD(tileBytesRead, text == NULL ? 0 : size);
+
+    bool valid = text != NULL && parse_tile_text_file(text, size, tiles);
+    release_file(text, size, mapped);
+    return valid ? NO_ERROR : TILE_INVALID;
 }
 
 /*
@@ -1,7 +1,21 @@
 #ifndef TILES_H
 #define TILES_H
-#define TILE_GRID_SQR_DIM 5
 #define TOTAL_ROTATION 4
+#define INITIAL_TILE_CAPACITY 16
+// Multiplier hashing the shape of a tile, the golden ratio of 2^64
+#define TILE_HASH_MULTIPLIER 0x9e3779b97f4a7c15ull
+// Mask of a single row within the mask of a tile rotation
+#define TILE_ROW_BITS ((1u << TILE_GRID_SQR_DIM) - 1)
+// Characters of a tile in a tile file, five rows each with a line termination
+#define TILE_TEXT_SIZE 30
+// Characters from the start of a tile to the start of the next tile
+#define TILE_TEXT_STRIDE 31
+// The line terminations within the characters of a tile
+#define TILE_LINE_BITS ((1u << 5) | (1u << 11) | (1u << 17) | (1u << 23) | \
+        (1u << 29))
+#define TILE_TEXT_BITS ((1u << TILE_TEXT_SIZE) - 1)
+// Bytes of a tile file given to each thread parsing it
+#define PARALLEL_TILE_BYTES (1024 * 1024)
 
 #include "definition.h"
 
@@ -17,8 +31,6 @@ void display_tiles(Tiles*, bool);
 
 ErrorCode show_only_tiles(char*, Tiles*); 
 
-bool validate_tile_dimension(int, int, int, int**);
-
 ErrorCode validate_tile_file(char*, Tiles*);
 
 void change_tiles(Game*);
@@ -53,6 +53,12 @@ TokenCode validate_tokens(char** tokens, int* command) {
         return SAVE_FILE;
     }
 
+    // Taking back and making again a move are single words
+    if (strlen(tokens[1]) == 0 && (strcmp(tokens[0], "undo") == 0 ||
+            strcmp(tokens[0], "redo") == 0)) {
+        return strcmp(tokens[0], "undo") == 0 ? UNDO_MOVE : REDO_MOVE;
+    }
+
     TokenCode validInteger = convert_token_to_int(tokens, command, 3);
     return validInteger;
 }
@@ -95,6 +101,8 @@ void tokenise_string(char** tokenList, char* string, int tokenLength) {
     const char* delimiter = " ";
     int totalToken = 0;
     char* currentToken;
+    // strtok_r keeps its position here so games can be parsed on many threads
+    char* position;
     
     int possibleTokens = 0; 
     int spaceChecker = 0;
@@ -109,7 +117,7 @@ void tokenise_string(char** tokenList, char* string, int tokenLength) {
     } while (string[spaceChecker] != '\0'); 
 
     // Getting first token match
-    currentToken = strtok(string, delimiter); 
+    currentToken = strtok_r(string, delimiter, &position); 
     /*  
         Moving to the next token, if the number of matched token is lesser than
         expected number of tokens and possible tokens is lesser than expected 
@@ -130,7 +138,7 @@ void tokenise_string(char** tokenList, char* string, int tokenLength) {
         // Copies the current token into a token array with corresponding index
         strcpy(tokenList[totalToken], currentToken);
         totalToken++;
-        currentToken = strtok(NULL, delimiter);
+        currentToken = strtok_r(NULL, delimiter, &position);
     }  
     // For remaining tokens setting it to be empty
     if (totalToken < tokenLength) {
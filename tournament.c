@@ -0,0 +1,257 @@
+#include "tournament.h"
+#include "game.h"
+#include <pthread.h>
+
+/* Separator of the values given for a single argument of a tournament */
+#define LIST_SEPARATOR ","
+
+/*
+    The arguments of a single game setup, laid out like the arguments of a
+    normal game: tile file, player types and either dimension or saved game.
+*/
+typedef struct {
+    char* arguments[6];
+} Matchup;
+
+/*
+    The outcome of a single game of the tournament, where winner is 1 if the
+    first player won and 2 if the second player won.
+*/
+typedef struct {
+    int winner;
+    int moves;
+    double elapsed;
+} GameResult;
+
+/*
+    Everything the worker threads share. Apart from nextGame, which hands
+    out the games, it is only read by the workers and every worker writes
+    the result of a game to its own slot of results.
+*/
+typedef struct {
+    int argn;
+    int totalMatchups;
+    Matchup* matchups;
+    int gamesEach;
+    int totalGames;
+    GameResult* results;
+    Options* options;
+    int nextGame;
+} Tournament;
+
+/*
+    Splits an argument of the tournament into its comma separated values.
+
+    @param argument the argument to be split, which is not modified
+    @param copy set to the copy of the argument the values point into
+    @param values set to the list of values
+    @returns the number of values
+*/
+static int split_list(char* argument, char** copy, char*** values) {
+    char* position;
+    int total = 0;
+    *copy = strdup(argument);
+    *values = malloc(sizeof(char*) * (strlen(argument) + 1));
+    for (char* value = strtok_r(*copy, LIST_SEPARATOR, &position);
+            value != NULL;
+            value = strtok_r(NULL, LIST_SEPARATOR, &position)) {
+        (*values)[total++] = value;
+    }
+    return total;
+}
+
+/*
+    Creates every combination of the values given for the arguments.
+
+    @param argn the number of arguments, either five or six
+    @param input the arguments, each a comma separated list of values
+    @param copies set to the copy of each argument, to be freed afterwards
+    @param lists set to the values of each argument, to be freed afterwards
+    @param matchups set to the list of combinations
+    @returns the number of combinations, zero if any argument has no value
+*/
+static int create_matchups(int argn, char** input, char** copies, 
+        char*** lists, Matchup** matchups) {
+    int counts[6];
+    int total = 1;
+    for (int index = 1; index < argn; index++) {
+        counts[index] = split_list(input[index], &copies[index], 
+                &lists[index]);
+        total *= counts[index];
+    }
+    *matchups = malloc(sizeof(Matchup) * (total > 0 ? total : 1));
+    for (int each = 0; each < total; each++) {
+        Matchup* matchup = &(*matchups)[each];
+        int remaining = each;
+        matchup->arguments[0] = input[0];
+        // The last argument changes fastest between matchups
+        for (int index = argn - 1; index >= 1; index--) {
+            matchup->arguments[index] = lists[index][remaining %
+                    counts[index]];
+            remaining /= counts[index];
+        }
+    }
+    return total;
+}
+
+/*
+    Sets up a game of a matchup to be played without display.
+
+    @param tournament the tournament the game belongs to
+    @param matchup the arguments of the game
+    @param game the game to be set up
+    @returns the ErrorCode of any invalid argument or NO_ERROR
+*/
+static ErrorCode setup_matchup(Tournament* tournament, Matchup* matchup,
+        Game* game) {
+    game->options = *tournament->options;
+    game->options.headless = true;
+    ErrorCode validGame = setup_game(tournament->argn, matchup->arguments,
+            game);
+    // A human cannot play without the board being displayed
+    if (validGame == NO_ERROR && (game->player1->type == HUMAN ||
+            game->player2->type == HUMAN)) {
+        validGame = PLAYER_INVALID;
+    }
+    return validGame;
+}
+
+/*
+    Plays games of the tournament until every game has been handed out. Each
+    game is set up and played on its own Game object, so workers share
+    nothing but the counter handing out the games.
+
+    @param data the tournament being played
+    @returns nothing
+*/
+static void* tournament_worker(void* data) {
+    Tournament* tournament = data;
+    while (true) {
+        int gameIndex = __atomic_fetch_add(&tournament->nextGame, 1,
+                __ATOMIC_RELAXED);
+        if (gameIndex >= tournament->totalGames) {
+            break;
+        }
+        Matchup* matchup =
+                &tournament->matchups[gameIndex / tournament->gamesEach];
+        GameResult* result = &tournament->results[gameIndex];
+        Game* game = initialise_game();
+        setup_matchup(tournament, matchup, game);
+        // The starting tile only depends on the seed and the game
+        if (tournament->options->seeded) {
+            uint64_t random = tournament->options->seed + gameIndex;
+            game->tiles->current = next_random(&random) % game->tiles->total;
+        }
+
+        double started = current_time();
+        play_game(game);
+        result->elapsed = current_time() - started;
+        result->moves = game->movesMade;
+        result->winner = game->winner == game->player1 ? 1 : 2;
+        free_game(game);
+    }
+    STATS_FLUSH();
+    return NULL;
+}
+
+/*
+    Prints the win rates and timing of every matchup followed by the total
+    time taken by the tournament.
+
+    @param tournament the tournament whose games have been played
+    @param threads the number of threads the games were played on
+    @param elapsed the wall time taken by the whole tournament
+*/
+static void report_tournament(Tournament* tournament, int threads,
+        double elapsed) {
+    int gamesEach = tournament->gamesEach;
+    double gameTime = 0;
+    for (int each = 0; each < tournament->totalMatchups; each++) {
+        int wins[2] = {0, 0};
+        long long moves = 0;
+        double time = 0;
+        for (int game = 0; game < gamesEach; game++) {
+            GameResult* result = 
+                    &tournament->results[each * gamesEach + game];
+            wins[result->winner - 1]++;
+            moves += result->moves;
+            time += result->elapsed;
+        }
+        gameTime += time;
+        for (int index = 1; index < tournament->argn; index++) {
+            printf("%s ", tournament->matchups[each].arguments[index]);
+        }
+        printf("=> * won %d (%.1f%%) # won %d (%.1f%%) %.1f moves/game "
+                "%.4fs/game %.0f moves/s\n", wins[0], 100.0 * wins[0] /
+                gamesEach, wins[1], 100.0 * wins[1] / gamesEach,
+                (double) moves / gamesEach, time / gamesEach,
+                time > 0 ? moves / time : 0);
+    }
+    printf("Tournament of %d games on %d threads took %.3fs (%.3fs of games, "
+            "%.2fx concurrency)\n", tournament->totalGames, threads, elapsed,
+            gameTime, elapsed > 0 ? gameTime / elapsed : 0);
+}
+
+/*
+    Plays a tournament where every argument may be a comma separated list of
+    values, e.g. "fitz a,b 1,2 1,2 10,100 10,100". Every combination of the
+    values is played the number of games given in the options by a pool of
+    worker threads, then the win rates and timing of every combination are
+    reported.
+
+    @param argn the number of arguments, either five or six
+    @param input the arguments, each a comma separated list of values
+    @param options the options including the number of threads
+    @returns the ErrorCode of the first invalid combination or NO_ERROR
+*/
+ErrorCode run_tournament(int argn, char** input, Options* options) {
+    char* copies[6];
+    char** lists[6];
+    Tournament tournament;
+    tournament.argn = argn;
+    tournament.options = options;
+    tournament.totalMatchups = create_matchups(argn, input, copies, lists,
+            &tournament.matchups);
+    tournament.gamesEach = options->games;
+    // The total is worked out wide as both factors can be large
+    long long totalGames = (long long) tournament.totalMatchups * 
+            options->games;
+    tournament.totalGames = totalGames <= TOURNAMENT_MAX_GAMES ? 
+            (int) totalGames : 0;
+    tournament.nextGame = 0;
+    ErrorCode result = tournament.totalMatchups > 0 && 
+            tournament.totalGames > 0 ? NO_ERROR : WRONG_PARAM;
+
+    // Every combination is checked before any game is played
+    for (int each = 0; each < tournament.totalMatchups &&
+            result == NO_ERROR; each++) {
+        Game* game = initialise_game();
+        result = setup_matchup(&tournament, &tournament.matchups[each], game);
+        free_game(game);
+    }
+
+    if (result == NO_ERROR) {
+        int threads = options->tournament < tournament.totalGames ?
+                options->tournament : tournament.totalGames;
+        pthread_t workers[MAX_THREADS];
+        tournament.results = malloc(sizeof(GameResult) *
+                tournament.totalGames);
+        double started = current_time();
+        for (int worker = 0; worker < threads; worker++) {
+            pthread_create(&workers[worker], NULL, tournament_worker,
+                    &tournament);
+        }
+        for (int worker = 0; worker < threads; worker++) {
+            pthread_join(workers[worker], NULL);
+        }
+        report_tournament(&tournament, threads, current_time() - started);
+        free(tournament.results);
+    }
+
+    for (int index = 1; index < argn; index++) {
+        free(copies[index]);
+        free(lists[index]);
+    }
+    free(tournament.matchups);
+    return result;
+}
@@ -0,0 +1,11 @@
+#ifndef TOURNAMENT_H
+#define TOURNAMENT_H
+// Most games of a tournament, leaving room for every worker to count past
+// the last game without overflowing
+#define TOURNAMENT_MAX_GAMES (INT_MAX - MAX_THREADS)
+
+#include "definition.h"
+
+ErrorCode run_tournament(int, char**, Options*);
+
+#endif
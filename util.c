@@ -0,0 +1,101 @@
+#include "util.h"
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+    Gets the time from a monotonic clock, used to measure how long games and
+    searches take.
+
+    @returns the current time in seconds
+*/
+double current_time(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec + now.tv_nsec / 1e9;
+}
+
+/*
+    Generates the next number of a pseudo random sequence using splitmix64,
+    which gives the same sequence for the same seed on every platform.
+
+    @param state the state of the sequence, advanced by every call
+    @returns the next 64-bit number of the sequence
+*/
+uint64_t next_random(uint64_t* state) {
+    uint64_t value = (*state += 0x9E3779B97F4A7C15ULL);
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+    return value ^ (value >> 31);
+}
+
+/*
+    Reads the whole content of a file that cannot be mapped, such as a pipe.
+
+    @param descriptor the open file to be read
+    @param size set to the number of characters read
+    @returns the content to be freed afterwards or NULL if it cannot be read
+*/
+static char* read_whole_file(int descriptor, size_t* size) {
+    size_t capacity = FILE_READ_SIZE;
+    char* content = malloc(capacity);
+    *size = 0;
+    while (true) {
+        if (*size == capacity) {
+            capacity *= 2;
+            content = realloc(content, capacity);
+        }
+        ssize_t count = read(descriptor, content + *size, capacity - *size);
+        if (count < 0) {
+            free(content);
+            return NULL;
+        } else if (count == 0) {
+            return content;
+        }
+        *size += count;
+    }
+}
+
+/*
+    Gets the whole content of an open file. Large regular files are mapped
+    into memory, while small files and files that cannot be mapped are read
+    into a buffer instead, as reading them is cheaper.
+
+    @param descriptor the open file, which may be closed afterwards
+    @param size set to the number of characters in the file
+    @param mapped set to whether the content is mapped
+    @returns the content to be released with release_file or NULL if the
+    file cannot be read
+*/
+char* read_file(int descriptor, size_t* size, bool* mapped) {
+    struct stat status;
+    *mapped = fstat(descriptor, &status) == 0 && S_ISREG(status.st_mode) &&
+            status.st_size >= FILE_MAP_BYTES;
+    if (*mapped) {
+        *size = status.st_size;
+        char* content = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, descriptor,
+                0);
+        if (content != MAP_FAILED) {
+            posix_madvise(content, *size, POSIX_MADV_SEQUENTIAL);
+            return content;
+        }
+        *mapped = false;
+    }
+    return read_whole_file(descriptor, size);
+}
+
+/*
+    Releases the content of a file given by read_file.
+
+    @param content the content of the file, which may be NULL
+    @param size the number of characters in the file
+    @param mapped whether the content is mapped
+*/
+void release_file(char* content, size_t size, bool mapped) {
+    if (mapped) {
+        munmap(content, size);
+    } else {
+        free(content);
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef UTIL_H
+#define UTIL_H
+// Smallest file that is mapped into memory rather than read
+#define FILE_MAP_BYTES (64 * 1024)
+// Bytes first read from a file that is not mapped
+#define FILE_READ_SIZE 4096
+
+#include "definition.h"
+
+double current_time(void);
+
+uint64_t next_random(uint64_t*);
+
+char* read_file(int, size_t*, bool*);
+
+void release_file(char*, size_t, bool);
+
+#endif